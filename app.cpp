@@ -1,7 +1,8 @@
 #include "app.h"
 
-App* App::currentInstance=nullptr;
-int App::currentInstanceHandle=0;
+thread_local App* App::currentInstance=nullptr;
+thread_local int App::currentInstanceHandle=0;
+std::mutex App::_instancesMutex;
 int App::_nextInstanceHandle=1;
 std::vector<App*> App::_allInstances;
 std::vector<int> App::_allInstanceHandles;
@@ -11,11 +12,38 @@ App::App(bool protectedEnv)
     objectContainer=new CObjectContainer();
     ikGroupContainer=new CIkGroupContainer();
     protectedEnvironment=protectedEnv;
+    _revision=0;
     _objectContainers.push_back(objectContainer);
     _ikGroupContainers.push_back(ikGroupContainer);
     _protectedEnvironments.push_back(protectedEnvironment);
 }
 
+App::App(CObjectContainer* objectCont,CIkGroupContainer* ikGroupCont,bool protectedEnv)
+{ // Takes ownership of the containers
+    objectContainer=objectCont;
+    ikGroupContainer=ikGroupCont;
+    protectedEnvironment=protectedEnv;
+    _revision=0;
+    _objectContainers.push_back(objectContainer);
+    _ikGroupContainers.push_back(ikGroupContainer);
+    _protectedEnvironments.push_back(protectedEnvironment);
+}
+
+App* App::copyYourself() const
+{ // Deep copy of the environment. The copy is not registered as an instance
+    return(new App(objectContainer->copyYourself(),ikGroupContainer->copyYourself(),protectedEnvironment));
+}
+
+void App::announceChanged()
+{ // Worker copies of the environment (see CIkWorkerPool) are made again before their next use
+    _revision++;
+}
+
+unsigned long long App::getRevision() const
+{
+    return(_revision);
+}
+
 App::~App()
 {
     while (_objectContainers.size()!=0)
@@ -38,6 +66,7 @@ App::~App()
 
 int App::addInstance(App* inst)
 {
+    std::lock_guard<std::mutex> lock(_instancesMutex);
     currentInstanceHandle=_nextInstanceHandle;
     currentInstance=inst;
     _allInstanceHandles.push_back(currentInstanceHandle);
@@ -46,9 +75,21 @@ int App::addInstance(App* inst)
     return(currentInstanceHandle);
 }
 
-bool App::switchToInstance(int handle,bool alsoProtectedEnv)
+App* App::getInstance(int handle,bool alsoProtectedEnv)
 {
-    if (currentInstanceHandle!=handle)
+    std::lock_guard<std::mutex> lock(_instancesMutex);
+    for (size_t i=0;i<_allInstanceHandles.size();i++)
+    {
+        if ( (_allInstanceHandles[i]==handle)&&(alsoProtectedEnv||(!_allInstances[i]->protectedEnvironment)) )
+            return(_allInstances[i]);
+    }
+    return(nullptr);
+}
+
+bool App::switchToInstance(int handle,bool alsoProtectedEnv)
+{ // Affects only the calling thread
+    std::lock_guard<std::mutex> lock(_instancesMutex);
+    if ( (currentInstanceHandle!=handle)||(currentInstance==nullptr) )
     {
         for (size_t i=0;i<_allInstanceHandles.size();i++)
         {
@@ -68,7 +109,8 @@ bool App::switchToInstance(int handle,bool alsoProtectedEnv)
 }
 
 int App::killInstance(int handle)
-{
+{ // Other threads should not have that environment as their current environment
+    std::lock_guard<std::mutex> lock(_instancesMutex);
     for (size_t i=0;i<_allInstanceHandles.size();i++)
     {
         if (_allInstanceHandles[i]==handle)
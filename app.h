@@ -2,29 +2,41 @@
 
 #include "objectContainer.h"
 #include "ikGroupContainer.h"
+#include "ikWorkerPool.h"
+#include <mutex>
 
 class App
 {
 public:
     App(bool protectedEnv);
+    App(CObjectContainer* objectCont,CIkGroupContainer* ikGroupCont,bool protectedEnv);
     virtual ~App();
 
+    App* copyYourself() const;
+    void announceChanged();
+    unsigned long long getRevision() const;
+
     static int addInstance(App* inst);
+    static App* getInstance(int handle,bool alsoProtectedEnv);
     static bool switchToInstance(int handle,bool alsoProtectedEnv);
     static int killInstance(int handle);
 
     CIkGroupContainer* ikGroupContainer;
     CObjectContainer* objectContainer;
     bool protectedEnvironment;
+    CIkWorkerPool workerPool; // for work spread over several threads, each with its own copy of the environment
 
-    static App* currentInstance;
-    static int currentInstanceHandle;
+    // The current environment is per thread, so that different environments can be handled in parallel:
+    static thread_local App* currentInstance;
+    static thread_local int currentInstanceHandle;
 
 private:
+    unsigned long long _revision; // incremented with each change made through the API
     std::vector<CIkGroupContainer*> _ikGroupContainers;
     std::vector<CObjectContainer*> _objectContainers;
     std::vector<bool> _protectedEnvironments;
 
+    static std::mutex _instancesMutex; // protects the variables below
     static int _nextInstanceHandle;
     static std::vector<App*> _allInstances;
     static std::vector<int> _allInstanceHandles;
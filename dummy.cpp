@@ -34,6 +34,11 @@ void CDummy::performSceneObjectLoadingMapping(const std::vector<int>* map)
     _linkedDummyHandle=_getLoadingMapping(map,_linkedDummyHandle);
 }
 
+CSceneObject* CDummy::copyYourself() const
+{
+    return(new CDummy(*this));
+}
+
 void CDummy::serialize(CSerialization& ar)
 {
     serializeMain(ar);
@@ -41,6 +46,20 @@ void CDummy::serialize(CSerialization& ar)
     _linkType=ar.readInt();
 }
 
+void CDummy::writeRecord(SIkObjectRecord& rec) const
+{
+    writeRecordMain(rec);
+    rec.ints[IK_OBJECT_DUMMY_LINKED_HANDLE]=_linkedDummyHandle;
+    rec.ints[IK_OBJECT_DUMMY_LINK_TYPE]=_linkType;
+}
+
+void CDummy::readRecord(const SIkObjectRecord& rec)
+{
+    readRecordMain(rec);
+    _linkedDummyHandle=rec.ints[IK_OBJECT_DUMMY_LINKED_HANDLE];
+    _linkType=rec.ints[IK_OBJECT_DUMMY_LINK_TYPE];
+}
+
 int CDummy::getLinkedDummyHandle() const
 {
     return(_linkedDummyHandle);
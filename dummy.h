@@ -14,6 +14,9 @@ public:
     void announceIkGroupWillBeErased(int ikGroupHandle);
     void performSceneObjectLoadingMapping(const std::vector<int>* map);
     void serialize(CSerialization& ar);
+    void writeRecord(SIkObjectRecord& rec) const;
+    void readRecord(const SIkObjectRecord& rec);
+    CSceneObject* copyYourself() const;
 
     int getLinkedDummyHandle() const;
     void setLinkedDummyHandle(int theHandle,bool setDirectly);
@@ -1,8 +1,17 @@
 #include "ik.h"
 #include "app.h"
 #include "simConst.h"
-
-static std::string lastError;
+#include "mappedFile.h"
+#include "ikModel.h"
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <cstring>
+#ifdef IK_CHECK_WORKER_COPIES
+#include <cassert>
+#endif
+
+static thread_local std::string lastError;
 
 std::string ikGetLastError()
 {
@@ -19,6 +28,17 @@ bool hasLaunched()
     return(retVal);
 }
 
+bool hasLaunchedOutsideSceneEdit()
+{ // For functions that rely on the joint, dummy or orphan lists, which are not up-to-date during a scene edit
+    bool retVal=hasLaunched();
+    if ( retVal&&App::currentInstance->objectContainer->isEditingScene() )
+    {
+        lastError="Not allowed during a scene edit";
+        retVal=false;
+    }
+    return(retVal);
+}
+
 CikElement* getIkElementFromIndexOrTipFrame(const CikGroup* ikGroup,int ikElementIndex)
 {
     CikElement* retVal=nullptr;
@@ -67,16 +87,68 @@ void ikReleaseBuffer(void* buffer)
     delete[] static_cast<simReal*>(buffer);
 }
 
-bool ikSwitchEnvironment(int handle,bool allowAlsoProtectedEnvironment/*=false*/)
+bool ikBeginSceneEdit()
+{ // Until ikEndSceneEdit, bookkeeping is deferred, so that building large scenes takes linear time
+    bool retVal=false;
+    if (hasLaunched())
+    {
+        App::currentInstance->announceChanged();
+        if (!App::currentInstance->objectContainer->isEditingScene())
+        {
+            App::currentInstance->objectContainer->beginSceneEdit();
+            retVal=true;
+        }
+        else
+            lastError="Scene edit already in progress";
+    }
+    return(retVal);
+}
+
+bool ikEndSceneEdit()
 {
     bool retVal=false;
     if (hasLaunched())
     {
-        if (App::switchToInstance(handle,allowAlsoProtectedEnvironment))
+        App::currentInstance->announceChanged();
+        if (App::currentInstance->objectContainer->isEditingScene())
+        {
+            App::currentInstance->objectContainer->endSceneEdit();
+            retVal=true;
+        }
+        else
+            lastError="No scene edit in progress";
+    }
+    return(retVal);
+}
+
+bool ikSwitchEnvironment(int handle,bool allowAlsoProtectedEnvironment/*=false*/)
+{ // Also allowed from a thread that has no current environment yet
+    bool retVal=false;
+    if (App::switchToInstance(handle,allowAlsoProtectedEnvironment))
+        retVal=true;
+    else
+        lastError="Invalid environment ID";
+    return(retVal);
+}
+
+bool ikDuplicateEnvironment(int environmentHandle,int* newEnvironmentHandle/*=nullptr*/)
+{ // Deep copy with the same handles, names and state. Like ikCreateEnvironment, switches to the new environment
+    bool retVal=false;
+    App* source=App::getInstance(environmentHandle,false);
+    if (source!=nullptr)
+    {
+        if (!source->objectContainer->isEditingScene())
+        {
+            int eh=App::addInstance(source->copyYourself());
+            if (newEnvironmentHandle!=nullptr)
+                newEnvironmentHandle[0]=eh;
             retVal=true;
+        }
         else
-            lastError="Invalid environment ID";
+            lastError="Not allowed during a scene edit";
     }
+    else
+        lastError="Invalid environment ID";
     return(retVal);
 }
 
@@ -85,14 +157,16 @@ bool ikLoad(const unsigned char* data,size_t dataLength)
     bool retVal=false;
     if (hasLaunched())
     {
+        App::currentInstance->announceChanged();
         if ( (App::currentInstance->objectContainer->objectList.size()==0)&&(App::currentInstance->ikGroupContainer->ikGroups.size()==0) )
         {
             if ((data!=nullptr)&&(dataLength!=0))
             {
                 CSerialization ar(data,dataLength);
-                App::currentInstance->objectContainer->importKinematicsData(ar);
-                App::currentInstance->objectContainer->objectList.size();
-                retVal=true;
+                if (App::currentInstance->objectContainer->importKinematicsData(ar))
+                    retVal=true;
+                else
+                    lastError="Invalid or truncated data";
             }
             else
                 lastError="Invalid arguments";
@@ -103,6 +177,49 @@ bool ikLoad(const unsigned char* data,size_t dataLength)
     return(retVal);
 }
 
+bool ikLoadFile(const char* path)
+{ // The file is parsed directly from a read-only mapping, i.e. without first reading it into a buffer
+    bool retVal=false;
+    if (hasLaunched())
+    {
+        App::currentInstance->announceChanged();
+        if ( (App::currentInstance->objectContainer->objectList.size()==0)&&(App::currentInstance->ikGroupContainer->ikGroups.size()==0) )
+        {
+            CMappedFile file;
+            if ( (path!=nullptr)&&file.open(path) )
+            {
+                CSerialization ar(file.getData(),file.getSize());
+                if (App::currentInstance->objectContainer->importKinematicsData(ar))
+                    retVal=true;
+                else
+                    lastError="Invalid or truncated data";
+            }
+            else
+                lastError="Cannot read file";
+        }
+        else
+            lastError="Environment must be empty";
+    }
+    return(retVal);
+}
+
+unsigned char* ikSave(size_t* dataLength)
+{
+    unsigned char* retVal=nullptr;
+    if (hasLaunched())
+    {
+        CSerialization ar;
+        App::currentInstance->objectContainer->exportKinematicsData(ar);
+        const std::vector<unsigned char>& data=ar.getWrittenData();
+        // Allocated like the other buffers returned by the API, so that ikReleaseBuffer can release it:
+        simReal* buffer=new simReal[(data.size()+sizeof(simReal)-1)/sizeof(simReal)];
+        retVal=reinterpret_cast<unsigned char*>(buffer);
+        memcpy(retVal,data.data(),data.size());
+        dataLength[0]=data.size();
+    }
+    return(retVal);
+}
+
 bool ikGetObjectHandle(const char* objectName,int* objectHandle)
 {
     bool retVal=false;
@@ -131,48 +248,148 @@ bool ikDoesObjectExist(const char* objectName)
     return(retVal);
 }
 
+bool getObjectTransformation(int objectHandle,int relativeToObjectHandle,C7Vector* transf)
+{ // In the current environment
+    bool retVal=false;
+    CSceneObject* it=App::currentInstance->objectContainer->getObject(objectHandle);
+    if (it!=nullptr)
+    {
+        if (relativeToObjectHandle==sim_handle_parent)
+        {
+            relativeToObjectHandle=-1;
+            CSceneObject* parent=it->getParentObject();
+            if (parent!=nullptr)
+                relativeToObjectHandle=parent->getObjectHandle();
+        }
+        CSceneObject* relObj=App::currentInstance->objectContainer->getObject(relativeToObjectHandle);
+        if ( (relativeToObjectHandle==-1)||(relObj!=nullptr) )
+        {
+            if (relativeToObjectHandle==-1)
+                transf[0]=it->getCumulativeTransformationPart1();
+            else
+            {
+                C7Vector relTr(relObj->getCumulativeTransformationPart1()); // added ..Part1 on 2010/06/14
+                transf[0]=relTr.getInverse()*it->getCumulativeTransformationPart1(); // Corrected bug on 2011/01/22: was getLocalTransformationPart1 before!!!
+            }
+            retVal=true;
+        }
+        else
+            lastError="Invalid arguments";
+    }
+    else
+        lastError="Invalid object handle";
+    return(retVal);
+}
+
 bool ikGetObjectTransformation(int objectHandle,int relativeToObjectHandle,C7Vector* transf)
 {
     bool retVal=false;
     if (hasLaunched())
+        retVal=getObjectTransformation(objectHandle,relativeToObjectHandle,transf);
+    return(retVal);
+}
+
+bool ikGetObjectMatrix(int objectHandle,int relativeToObjectHandle,C4X4Matrix* matrix)
+{
+    C7Vector transf;
+    bool retVal=ikGetObjectTransformation(objectHandle,relativeToObjectHandle,&transf);
+    if (retVal)
+        matrix[0]=transf.getMatrix();
+    return(retVal);
+}
+
+bool getBatchJoints(size_t jointCnt,const int* jointHandles,std::vector<const CJoint*>& joints)
+{
+    bool retVal=true;
+    for (size_t i=0;i<jointCnt;i++)
     {
-        CSceneObject* it=App::currentInstance->objectContainer->getObject(objectHandle);
-        if (it!=nullptr)
+        CJoint* it=App::currentInstance->objectContainer->getJoint(jointHandles[i]);
+        if (it==nullptr)
         {
-            if (relativeToObjectHandle==sim_handle_parent)
+            lastError="Invalid joint handle";
+            retVal=false;
+            break;
+        }
+        if (it->getJointType()==sim_joint_spherical_subtype)
+        {
+            lastError="Invalid call with spherical joint";
+            retVal=false;
+            break;
+        }
+        joints.push_back(it);
+    }
+    return(retVal);
+}
+
+bool ikComputePosesBatch(size_t frameCnt,const int* frameHandles,size_t jointCnt,const int* jointHandles,size_t configCnt,const simReal* configs,C7Vector* poses)
+{ // configs: configCnt rows of jointCnt values. poses: frameCnt rows of configCnt absolute poses. The scene is not modified
+    bool retVal=false;
+    if (hasLaunched())
+    {
+        if ( (frameCnt>0)&&(frameHandles!=nullptr)&&(configCnt>0)&&(configs!=nullptr)&&(poses!=nullptr)&&((jointCnt==0)||(jointHandles!=nullptr)) )
+        {
+            std::vector<const CSceneObject*> frames;
+            for (size_t i=0;i<frameCnt;i++)
             {
-                relativeToObjectHandle=-1;
-                CSceneObject* parent=it->getParentObject();
-                if (parent!=nullptr)
-                    relativeToObjectHandle=parent->getObjectHandle();
+                CSceneObject* it=App::currentInstance->objectContainer->getObject(frameHandles[i]);
+                if (it==nullptr)
+                    break;
+                frames.push_back(it);
             }
-            CSceneObject* relObj=App::currentInstance->objectContainer->getObject(relativeToObjectHandle);
-            if ( (relativeToObjectHandle==-1)||(relObj!=nullptr) )
+            if (frames.size()==frameCnt)
             {
-                if (relativeToObjectHandle==-1)
-                    transf[0]=it->getCumulativeTransformationPart1();
-                else
+                std::vector<const CJoint*> joints;
+                if (getBatchJoints(jointCnt,jointHandles,joints))
                 {
-                    C7Vector relTr(relObj->getCumulativeTransformationPart1()); // added ..Part1 on 2010/06/14
-                    transf[0]=relTr.getInverse()*it->getCumulativeTransformationPart1(); // Corrected bug on 2011/01/22: was getLocalTransformationPart1 before!!!
+                    App::currentInstance->objectContainer->getWorldTransformationsBatch(frameCnt,frames.data(),jointCnt,joints.data(),configCnt,configs,poses);
+                    retVal=true;
                 }
-                retVal=true;
             }
             else
-                lastError="Invalid arguments";
+                lastError="Invalid object handle";
         }
         else
-            lastError="Invalid object handle";
+            lastError="Invalid arguments";
     }
     return(retVal);
 }
 
-bool ikGetObjectMatrix(int objectHandle,int relativeToObjectHandle,C4X4Matrix* matrix)
-{
-    C7Vector transf;
-    bool retVal=ikGetObjectTransformation(objectHandle,relativeToObjectHandle,&transf);
-    if (retVal)
-        matrix[0]=transf.getMatrix();
+bool ikComputeTipPosesBatch(int ikGroupHandle,size_t jointCnt,const int* jointHandles,size_t configCnt,const simReal* configs,C7Vector* tipPoses)
+{ // Same as ikComputePosesBatch, with the tips of the IK group's elements as frames (in element order)
+    bool retVal=false;
+    if (hasLaunched())
+    {
+        CikGroup* ikGroup=App::currentInstance->ikGroupContainer->getIkGroup(ikGroupHandle);
+        if (ikGroup!=nullptr)
+        {
+            if ( (configCnt>0)&&(configs!=nullptr)&&(tipPoses!=nullptr)&&((jointCnt==0)||(jointHandles!=nullptr)) )
+            {
+                std::vector<const CSceneObject*> frames;
+                for (size_t i=0;i<ikGroup->ikElements.size();i++)
+                {
+                    CSceneObject* it=App::currentInstance->objectContainer->getDummy(ikGroup->ikElements[i]->getTipHandle());
+                    if (it==nullptr)
+                        break;
+                    frames.push_back(it);
+                }
+                if ( (frames.size()!=0)&&(frames.size()==ikGroup->ikElements.size()) )
+                {
+                    std::vector<const CJoint*> joints;
+                    if (getBatchJoints(jointCnt,jointHandles,joints))
+                    {
+                        App::currentInstance->objectContainer->getWorldTransformationsBatch(frames.size(),frames.data(),jointCnt,joints.data(),configCnt,configs,tipPoses);
+                        retVal=true;
+                    }
+                }
+                else
+                    lastError="Ill-defined IK group";
+            }
+            else
+                lastError="Invalid arguments";
+        }
+        else
+            lastError="Invalid IK group handle";
+    }
     return(retVal);
 }
 
@@ -181,6 +398,7 @@ bool ikSetObjectTransformation(int objectHandle,int relativeToObjectHandle,const
     bool retVal=false;
     if (hasLaunched())
     {
+        App::currentInstance->announceChanged();
         CSceneObject* it=App::currentInstance->objectContainer->getObject(objectHandle);
         if (it!=nullptr)
         {
@@ -246,6 +464,7 @@ bool ikSetJointPosition(int jointHandle,simReal position)
     bool retVal=false;
     if (hasLaunched())
     {
+        App::currentInstance->announceChanged();
         CJoint* it=App::currentInstance->objectContainer->getJoint(jointHandle);
         if (it!=nullptr)
         {
@@ -296,6 +515,7 @@ bool ikCreateIkGroup(const char* ikGroupName/*=nullptr*/,int* ikGroupHandle)
     bool retVal=false;
     if (hasLaunched())
     {
+        App::currentInstance->announceChanged();
         if ( (ikGroupName==nullptr)||((strlen(ikGroupName)>0)&&(App::currentInstance->ikGroupContainer->getIkGroup(ikGroupName)==nullptr)) )
         {
             CikGroup* it=new CikGroup();
@@ -317,6 +537,7 @@ bool ikAddIkElement(int ikGroupHandle,int tipHandle,int* ikElementIndex)
     bool retVal=false;
     if (hasLaunched())
     {
+        App::currentInstance->announceChanged();
         CikGroup* ikGroup=App::currentInstance->ikGroupContainer->getIkGroup(ikGroupHandle);
         if (ikGroup!=nullptr)
         {
@@ -342,6 +563,7 @@ bool ikSetIkElementEnabled(int ikGroupHandle,int ikElementIndex,bool enabled)
     bool retVal=false;
     if (hasLaunched())
     {
+        App::currentInstance->announceChanged();
         CikGroup* ikGroup=App::currentInstance->ikGroupContainer->getIkGroup(ikGroupHandle);
         if (ikGroup!=nullptr)
         {
@@ -384,6 +606,7 @@ bool ikSetIkElementBase(int ikGroupHandle,int ikElementIndex,int baseHandle,int
     bool retVal=false;
     if (hasLaunched())
     {
+        App::currentInstance->announceChanged();
         CikGroup* ikGroup=App::currentInstance->ikGroupContainer->getIkGroup(ikGroupHandle);
         if (ikGroup!=nullptr)
         {
@@ -442,6 +665,7 @@ bool ikSetIkElementConstraints(int ikGroupHandle,int ikElementIndex,int constrai
     bool retVal=false;
     if (hasLaunched())
     {
+        App::currentInstance->announceChanged();
         CikGroup* ikGroup=App::currentInstance->ikGroupContainer->getIkGroup(ikGroupHandle);
         if (ikGroup!=nullptr)
         {
@@ -485,6 +709,7 @@ bool ikSetIkElementPrecision(int ikGroupHandle,int ikElementIndex,simReal linear
     bool retVal=false;
     if (hasLaunched())
     {
+        App::currentInstance->announceChanged();
         CikGroup* ikGroup=App::currentInstance->ikGroupContainer->getIkGroup(ikGroupHandle);
         if (ikGroup!=nullptr)
         {
@@ -531,6 +756,7 @@ bool ikSetIkElementWeights(int ikGroupHandle,int ikElementIndex,simReal linearWe
     bool retVal=false;
     if (hasLaunched())
     {
+        App::currentInstance->announceChanged();
         CikGroup* ikGroup=App::currentInstance->ikGroupContainer->getIkGroup(ikGroupHandle);
         if (ikGroup!=nullptr)
         {
@@ -575,8 +801,9 @@ bool ikGetIkElementWeights(int ikGroupHandle,int ikElementIndex,simReal* linearW
 bool ikComputeJacobian(int ikGroupHandle,int options,bool* success/*=nullptr*/)
 {
     bool retVal=false;
-    if (hasLaunched())
+    if (hasLaunchedOutsideSceneEdit())
     {
+        App::currentInstance->announceChanged();
         CikGroup* it=App::currentInstance->ikGroupContainer->getIkGroup(ikGroupHandle);
         if (it!=nullptr)
         {
@@ -631,27 +858,214 @@ bool ikGetManipulability(int ikGroupHandle,simReal* manip)
     return(retVal);
 }
 
-bool ikHandleIkGroup(int ikGroupHandle,int* result/*=nullptr*/)
+bool handleIkGroup(int ikGroupHandle,int* result,size_t workerCnt)
+{ // In the current environment. workerCnt only matters when all groups are handled
+    bool retVal=false;
+    CikGroup* it=App::currentInstance->ikGroupContainer->getIkGroup(ikGroupHandle);
+    if ( (ikGroupHandle==sim_handle_all)||(ikGroupHandle==sim_handle_all_except_explicit)||(it!=nullptr) )
+    {
+        if (ikGroupHandle<0)
+        {
+            if (workerCnt==0)
+                workerCnt=std::max<size_t>(1,std::thread::hardware_concurrency());
+            retVal=App::currentInstance->ikGroupContainer->computeAllIkGroups(ikGroupHandle==sim_handle_all_except_explicit,workerCnt);
+        }
+        else
+        { // explicit handling
+            if (it->getExplicitHandling())
+            {
+                int res=it->computeGroupIk(false);
+                if (result!=nullptr)
+                    result[0]=res;
+                retVal=true;
+            }
+            else
+                lastError="IK group cannot explicitely be handled";
+        }
+    }
+    else
+        lastError="Invalid IK group handle";
+    return(retVal);
+}
+
+bool ikHandleIkGroup(int ikGroupHandle,int* result/*=nullptr*/,size_t workerCnt/*=1*/)
 {
     bool retVal=false;
-    if (hasLaunched())
+    if (hasLaunchedOutsideSceneEdit())
     {
-        CikGroup* it=App::currentInstance->ikGroupContainer->getIkGroup(ikGroupHandle);
-        if ( (ikGroupHandle==sim_handle_all)||(ikGroupHandle==sim_handle_all_except_explicit)||(it!=nullptr) )
+        App::currentInstance->announceChanged();
+        retVal=handleIkGroup(ikGroupHandle,result,workerCnt);
+    }
+    return(retVal);
+}
+
+bool solveIkGroup(int ikGroupHandle,size_t jointCnt,const int* jointHandles,const simReal* initialJointValues,const C7Vector* targetPoses,simReal* jointValues,int* result,simReal* residuals,int* iterations)
+{ // In the current environment, whose joint positions are not modified
+    bool retVal=false;
+    CikGroup* it=App::currentInstance->ikGroupContainer->getIkGroup(ikGroupHandle);
+    if (it!=nullptr)
+    {
+        std::vector<CJoint*> joints;
+        std::vector<simReal> initialValues;
+        int err=0;
+        for (size_t i=0;i<jointCnt;i++)
         {
-            if (ikGroupHandle<0)
-                retVal=App::currentInstance->ikGroupContainer->computeAllIkGroups(ikGroupHandle==sim_handle_all_except_explicit);
+            CJoint* aJoint=App::currentInstance->objectContainer->getJoint(jointHandles[i]);
+            if (aJoint==nullptr)
+                err=1;
             else
-            { // explicit handling
-                if (it->getExplicitHandling())
+            {
+                if (aJoint->getJointType()==sim_joint_spherical_subtype)
+                    err=2;
+                joints.push_back(aJoint);
+                if (initialJointValues!=nullptr)
+                    initialValues.push_back(initialJointValues[i]);
+                else
+                    initialValues.push_back(aJoint->getPosition());
+            }
+        }
+        if (err==0)
+        {
+            int res=it->solveGroupIk(joints,initialValues.data(),targetPoses,jointValues,residuals,iterations);
+            if (result!=nullptr)
+                result[0]=res;
+            retVal=true;
+        }
+        else
+        {
+            if (err==1)
+                lastError="Found invalid joint handle(s)";
+            if (err==2)
+                lastError="Spherical joints are not supported";
+        }
+    }
+    else
+        lastError="Invalid IK group handle";
+    return(retVal);
+}
+
+bool ikSolveIkGroup(int ikGroupHandle,size_t jointCnt,const int* jointHandles,const simReal* initialJointValues,const C7Vector* targetPoses,simReal* jointValues,int* result/*=nullptr*/,simReal* residuals/*=nullptr*/,int* iterations/*=nullptr*/)
+{
+    bool retVal=false;
+    if (hasLaunchedOutsideSceneEdit())
+    {
+        App::currentInstance->announceChanged();
+        retVal=solveIkGroup(ikGroupHandle,jointCnt,jointHandles,initialJointValues,targetPoses,jointValues,result,residuals,iterations);
+    }
+    return(retVal);
+}
+
+void solveIkGroupBatchSamples(int ikGroupHandle,const std::vector<int>* jointHandles,size_t sampleCnt,const C7Vector* targetPoses,size_t seedCnt,const simReal* seeds,simReal* jointValues,int* results,std::atomic<size_t>* nextSample)
+{ // In the current environment. Samples are picked one after the other, until all were handled (by this or other workers).
+    // A sample does not depend on the ones handled before, i.e. the result does not depend on the number of workers
+    CikGroup* ikGroup=App::currentInstance->ikGroupContainer->getIkGroup(ikGroupHandle);
+    std::vector<CJoint*> joints;
+    std::vector<simReal> currentValues;
+    for (size_t i=0;i<jointHandles->size();i++)
+    {
+        CJoint* joint=App::currentInstance->objectContainer->getJoint(jointHandles->at(i));
+        joints.push_back(joint);
+        currentValues.push_back(joint->getPosition());
+    }
+    size_t jointCnt=joints.size();
+    size_t elementCnt=ikGroup->ikElements.size();
+    while (true)
+    {
+        size_t i=nextSample->fetch_add(1);
+        if (i>=sampleCnt)
+            break;
+        int res=sim_ikresult_not_performed;
+        if (seedCnt==0)
+            res=ikGroup->solveGroupIk(joints,currentValues.data(),targetPoses+i*elementCnt,jointValues+i*jointCnt,nullptr,nullptr);
+        else
+        { // try the seeds until one succeeds:
+            for (size_t j=0;j<seedCnt;j++)
+            {
+                res=ikGroup->solveGroupIk(joints,seeds+(i*seedCnt+j)*jointCnt,targetPoses+i*elementCnt,jointValues+i*jointCnt,nullptr,nullptr);
+                if (res==sim_ikresult_success)
+                    break;
+            }
+        }
+        if (results!=nullptr)
+            results[i]=res;
+    }
+}
+
+struct SSolveIkGroupBatchTask
+{
+    int ikGroupHandle;
+    const std::vector<int>* jointHandles;
+    size_t sampleCnt;
+    const C7Vector* targetPoses;
+    size_t seedCnt;
+    const simReal* seeds;
+    simReal* jointValues;
+    int* results;
+    std::atomic<size_t>* nextSample;
+};
+
+void solveIkGroupBatchWorker(void* data,size_t /*workerIndex*/,size_t /*workerCnt*/)
+{ // Works on its own copy of the environment (see CIkWorkerPool), whose solver workspaces are reused from one call to the next
+    SSolveIkGroupBatchTask* task=static_cast<SSolveIkGroupBatchTask*>(data);
+    solveIkGroupBatchSamples(task->ikGroupHandle,task->jointHandles,task->sampleCnt,task->targetPoses,task->seedCnt,task->seeds,task->jointValues,task->results,task->nextSample);
+}
+
+bool ikSolveIkGroupBatch(int ikGroupHandle,size_t jointCnt,const int* jointHandles,size_t sampleCnt,const C7Vector* targetPoses,size_t seedCnt,const simReal* seeds,simReal* jointValues,int* results/*=nullptr*/,size_t workerCnt/*=1*/)
+{
+    bool retVal=false;
+    if (hasLaunchedOutsideSceneEdit())
+    {
+        CikGroup* ikGroup=App::currentInstance->ikGroupContainer->getIkGroup(ikGroupHandle);
+        if (ikGroup!=nullptr)
+        {
+            int err=0;
+            for (size_t i=0;i<jointCnt;i++)
+            {
+                CJoint* aJoint=App::currentInstance->objectContainer->getJoint(jointHandles[i]);
+                if (aJoint==nullptr)
+                    err=1;
+                else
                 {
-                    int res=it->computeGroupIk(false);
-                    if (result!=nullptr)
-                        result[0]=res;
-                    retVal=true;
+                    if (aJoint->getJointType()==sim_joint_spherical_subtype)
+                        err=2;
+                }
+            }
+            if (err==0)
+            {
+                if (seeds==nullptr)
+                    seedCnt=0;
+                std::vector<int> handles(jointHandles,jointHandles+jointCnt);
+                std::atomic<size_t> nextSample(0);
+                if (workerCnt==0)
+                    workerCnt=std::max<size_t>(1,std::thread::hardware_concurrency());
+                workerCnt=std::min<size_t>(workerCnt,sampleCnt);
+                if (workerCnt<=1)
+                {
+                    App::currentInstance->announceChanged();
+                    solveIkGroupBatchSamples(ikGroupHandle,&handles,sampleCnt,targetPoses,seedCnt,seeds,jointValues,results,&nextSample);
                 }
                 else
-                    lastError="IK group cannot explicitely be handled";
+                { // each worker with its own copy of the environment, that is kept for the next call:
+                    SSolveIkGroupBatchTask task;
+                    task.ikGroupHandle=ikGroupHandle;
+                    task.jointHandles=&handles;
+                    task.sampleCnt=sampleCnt;
+                    task.targetPoses=targetPoses;
+                    task.seedCnt=seedCnt;
+                    task.seeds=seeds;
+                    task.jointValues=jointValues;
+                    task.results=results;
+                    task.nextSample=&nextSample;
+                    App::currentInstance->workerPool.run(workerCnt,solveIkGroupBatchWorker,&task);
+                }
+                retVal=true;
+            }
+            else
+            {
+                if (err==1)
+                    lastError="Found invalid joint handle(s)";
+                if (err==2)
+                    lastError="Spherical joints are not supported";
             }
         }
         else
@@ -694,6 +1108,7 @@ bool ikSetSphericalJointQuaternion(int jointHandle,const C4Vector* quaternion)
     bool retVal=false;
     if (hasLaunched())
     {
+        App::currentInstance->announceChanged();
         CJoint* it=App::currentInstance->objectContainer->getJoint(jointHandle);
         if (it!=nullptr)
         {
@@ -741,6 +1156,7 @@ bool ikSetObjectParent(int objectHandle,int parentObjectHandle,bool keepInPlace)
     bool retVal=false;
     if (hasLaunched())
     {
+        App::currentInstance->announceChanged();
         CSceneObject* it=App::currentInstance->objectContainer->getObject(objectHandle);
         CSceneObject* parentIt=App::currentInstance->objectContainer->getObject(parentObjectHandle);
         if (it!=nullptr)
@@ -767,6 +1183,7 @@ bool ikCreateFrame(const char* frameName/*=nullptr*/,int* frameHandle)
     bool retVal=false;
     if (hasLaunched())
     {
+        App::currentInstance->announceChanged();
         if ( (frameName==nullptr)||((strlen(frameName)!=0)&&(App::currentInstance->objectContainer->getObject(frameName)==nullptr)) )
         {
             frameHandle[0]=App::currentInstance->objectContainer->createDummy(frameName);
@@ -783,6 +1200,7 @@ bool ikSetLinkedFrame(int frameHandle,int linkedFrameHandle)
     bool retVal=false;
     if (hasLaunched())
     {
+        App::currentInstance->announceChanged();
         CDummy* it=App::currentInstance->objectContainer->getDummy(frameHandle);
         if (it!=nullptr)
         {
@@ -831,6 +1249,7 @@ bool ikCreateJoint(const char* jointName/*=nullptr*/,int jointType,int* jointHan
     bool retVal=false;
     if (hasLaunched())
     {
+        App::currentInstance->announceChanged();
         if ( (jointName==nullptr)||((strlen(jointName)!=0)&&(App::currentInstance->objectContainer->getObject(jointName)==nullptr)) )
         {
             jointHandle[0]=App::currentInstance->objectContainer->createJoint(jointName,jointType);
@@ -847,6 +1266,7 @@ bool ikSetJointMode(int jointHandle,int jointMode)
     bool retVal=false;
     if (hasLaunched())
     {
+        App::currentInstance->announceChanged();
         CJoint* it=App::currentInstance->objectContainer->getJoint(jointHandle);
         if (it!=nullptr)
         {
@@ -882,6 +1302,7 @@ bool ikSetJointInterval(int jointHandle,bool cyclic,const simReal* intervalMinAn
     bool retVal=false;
     if (hasLaunched())
     {
+        App::currentInstance->announceChanged();
         CJoint* it=App::currentInstance->objectContainer->getJoint(jointHandle);
         if (it!=nullptr)
         {
@@ -909,6 +1330,7 @@ bool ikSetJointScrewPitch(int jointHandle,simReal pitch)
     bool retVal=false;
     if (hasLaunched())
     {
+        App::currentInstance->announceChanged();
         CJoint* it=App::currentInstance->objectContainer->getJoint(jointHandle);
         if (it!=nullptr)
         {
@@ -927,6 +1349,7 @@ bool ikSetJointIkWeight(int jointHandle,simReal ikWeight)
     bool retVal=false;
     if (hasLaunched())
     {
+        App::currentInstance->announceChanged();
         CJoint* it=App::currentInstance->objectContainer->getJoint(jointHandle);
         if (it!=nullptr)
         {
@@ -962,6 +1385,7 @@ bool ikSetJointMaxStepSize(int jointHandle,simReal maxStepSize)
     bool retVal=false;
     if (hasLaunched())
     {
+        App::currentInstance->announceChanged();
         CJoint* it=App::currentInstance->objectContainer->getJoint(jointHandle);
         if (it!=nullptr)
         {
@@ -997,6 +1421,7 @@ bool ikSetJointDependency(int jointHandle,int dependencyJointHandle,simReal offs
     bool retVal=false;
     if (hasLaunched())
     {
+        App::currentInstance->announceChanged();
         CJoint* it=App::currentInstance->objectContainer->getJoint(jointHandle);
         if (it!=nullptr)
         {
@@ -1053,6 +1478,7 @@ bool ikEraseObject(int objectHandle)
     bool retVal=false;
     if (hasLaunched())
     {
+        App::currentInstance->announceChanged();
         CSceneObject* obj=App::currentInstance->objectContainer->getObject(objectHandle);
         if (obj!=nullptr)
             retVal=App::currentInstance->objectContainer->eraseObject(obj);
@@ -1122,6 +1548,7 @@ bool ikSetIkGroupCalculation(int ikGroupHandle,int method,simReal damping,int ma
     bool retVal=false;
     if (hasLaunched())
     {
+        App::currentInstance->announceChanged();
         CikGroup* it=App::currentInstance->ikGroupContainer->getIkGroup(ikGroupHandle);
         if (it!=nullptr)
         {
@@ -1162,6 +1589,7 @@ bool ikSetIkGroupLimitThresholds(int ikGroupHandle,const simReal* linearAndAngul
     bool retVal=false;
     if (hasLaunched())
     {
+        App::currentInstance->announceChanged();
         CikGroup* it=App::currentInstance->ikGroupContainer->getIkGroup(ikGroupHandle);
         if (it!=nullptr)
         {
@@ -1183,6 +1611,7 @@ bool ikSetIkGroupFlags(int ikGroupHandle,int flags)
     bool retVal=false;
     if (hasLaunched())
     {
+        App::currentInstance->announceChanged();
         CikGroup* it=App::currentInstance->ikGroupContainer->getIkGroup(ikGroupHandle);
         if (it!=nullptr)
         {
@@ -1223,11 +1652,238 @@ bool ikGetIkGroupFlags(int ikGroupHandle,int* flags)
     return(retVal);
 }
 
-int ikGetConfigForTipPose(int ikGroupHandle,size_t jointCnt,const int* jointHandles,simReal thresholdDist,int maxIterations,simReal* retConfig,const simReal* metric/*=nullptr*/,bool(*validationCallback)(simReal*)/*=nullptr*/,const int* jointOptions/*=nullptr*/,const simReal* lowLimits/*=nullptr*/,const simReal* ranges/*=nullptr*/)
+int getConfigForTipPoseFrames(const CikGroup* ikGroup,std::vector<CDummy*>& tips,std::vector<CDummy*>& targets,std::vector<CSceneObject*>& bases)
+{ // returns 0 if ok, 2 if an element is ill-defined, 3 if the group has no element
+    int retVal=0;
+    if (ikGroup->ikElements.size()>0)
+    {
+        for (size_t i=0;i<ikGroup->ikElements.size();i++)
+        {
+            CDummy* tip=App::currentInstance->objectContainer->getDummy(ikGroup->ikElements[i]->getTipHandle());
+            CDummy* target=App::currentInstance->objectContainer->getDummy(ikGroup->ikElements[i]->getTargetHandle());
+            CSceneObject* base=nullptr;
+            if (ikGroup->ikElements[i]->getAltBaseHandleForConstraints()!=-1)
+                base=App::currentInstance->objectContainer->getObject(ikGroup->ikElements[i]->getAltBaseHandleForConstraints());
+            else
+                base=App::currentInstance->objectContainer->getObject(ikGroup->ikElements[i]->getBaseHandle());
+            if ((tip==nullptr)||(target==nullptr))
+                retVal=2;
+            tips.push_back(tip);
+            targets.push_back(target);
+            bases.push_back(base);
+        }
+    }
+    else
+        retVal=3;
+    return(retVal);
+}
+
+bool tryConfigForTipPose(CikGroup* ikGroup,const std::vector<CJoint*>& joints,const std::vector<CDummy*>& tips,const std::vector<CDummy*>& targets,const std::vector<CSceneObject*>& bases,const simReal* theMetric,simReal thresholdDist,bool(*validationCallback)(simReal*),std::vector<simReal>& conf)
+{ // conf holds the random state to try. In case of success, conf holds the found configuration
+    // 1. Apply the random state:
+    for (size_t i=0;i<joints.size();i++)
+        joints[i]->setPosition(conf[i]);
+
+    // 2. Check distances between tip and target pairs (there might be several pairs!):
+    simReal cumulatedDist=simZero;
+    for (size_t el=0;el<ikGroup->ikElements.size();el++)
+    {
+        C7Vector tipTr(tips[el]->getCumulativeTransformation());
+        C7Vector targetTr(targets[el]->getCumulativeTransformation());
+        C7Vector relTrInv(C7Vector::identityTransformation);
+        if (bases[el]!=nullptr)
+            relTrInv=bases[el]->getCumulativeTransformationPart1().getInverse();
+        tipTr=relTrInv*tipTr;
+        targetTr=relTrInv*targetTr;
+        C3Vector dx(tipTr.X-targetTr.X);
+        dx(0)*=theMetric[0];
+        dx(1)*=theMetric[1];
+        dx(2)*=theMetric[2];
+        simReal angle=tipTr.Q.getAngleBetweenQuaternions(targetTr.Q)*theMetric[3];
+        cumulatedDist+=sqrt(dx(0)*dx(0)+dx(1)*dx(1)+dx(2)*dx(2)+angle*angle);
+    }
+
+    // 3. If distance<=threshold, try to perform IK:
+    if (cumulatedDist<=thresholdDist)
+    {
+        if (sim_ikresult_success==ikGroup->computeGroupIk(true))
+        { // 3.1 We found a configuration that works!
+            // 3.2 Finally check if the callback accepts that configuration:
+            for (size_t i=0;i<joints.size();i++)
+                conf[i]=joints[i]->getPosition();
+            if ( (validationCallback==nullptr)||validationCallback(&conf[0]) )
+                return(true);
+        }
+    }
+    return(false);
+}
+
+simReal getSampleRandomValue(unsigned long long& state)
+{ // splitmix64, returns a value in [0;1]
+    state+=0x9E3779B97F4A7C15ULL;
+    unsigned long long z=state;
+    z=(z^(z>>30))*0xBF58476D1CE4E5B9ULL;
+    z=(z^(z>>27))*0x94D049BB133111EBULL;
+    z=z^(z>>31);
+    return(simReal(double(z>>11)*(1.0/9007199254740991.0)));
+}
+
+struct SConfigForTipPoseState
+{
+    std::vector<CJoint*> sceneJoints;
+    std::vector<simReal> initSceneJointValues;
+    std::vector<C4Vector> initSceneJointQuaternions;
+    std::vector<int> initSceneJointModes;
+    std::vector<int> initSceneJointDependencies;
+    std::vector<simReal> initSceneJointDependencyOffsets;
+    std::vector<simReal> initSceneJointDependencyMults;
+    bool ikGroupWasActive;
+    std::vector<bool> enabledElements;
+};
+
+void prepareConfigForTipPose(CikGroup* ikGroup,const std::vector<CJoint*>& joints,const int* jointOptions,SConfigForTipPoseState& state)
+{ // In the current environment. Saves what the search modifies, then sets the joint modes and activates the group
+    // Save joint positions/modes (all of them, just in case)
+    for (size_t i=0;i<App::currentInstance->objectContainer->jointList.size();i++)
+    {
+        CJoint* aj=App::currentInstance->objectContainer->getJoint(App::currentInstance->objectContainer->jointList[i]);
+        state.sceneJoints.push_back(aj);
+        state.initSceneJointValues.push_back(aj->getPosition());
+        state.initSceneJointQuaternions.push_back(aj->getSphericalTransformation());
+        state.initSceneJointModes.push_back(aj->getJointMode());
+        state.initSceneJointDependencies.push_back(aj->getDependencyJointHandle()); // cleared when set to passive mode
+        state.initSceneJointDependencyOffsets.push_back(aj->getDependencyJointAdd());
+        state.initSceneJointDependencyMults.push_back(aj->getDependencyJointMult());
+    }
+
+    ikGroup->setAllInvolvedJointsToPassiveMode();
+
+    state.ikGroupWasActive=ikGroup->getActive();
+    if (!state.ikGroupWasActive)
+        ikGroup->setActive(true);
+
+    // It can happen that some IK elements get deactivated when the user provided wrong handles, so save the activation state:
+    for (size_t i=0;i<ikGroup->ikElements.size();i++)
+        state.enabledElements.push_back(ikGroup->ikElements[i]->getIsActive());
+
+    // Set the correct mode for the joints involved:
+    for (size_t i=0;i<joints.size();i++)
+    {
+        if ( (jointOptions==nullptr)||((jointOptions[i]&1)==0) )
+            joints[i]->setJointMode(sim_jointmode_ik);
+        else
+            joints[i]->setJointMode(sim_jointmode_dependent);
+    }
+}
+
+void restoreConfigForTipPose(CikGroup* ikGroup,const SConfigForTipPoseState& state,bool exact)
+{ // Undoes prepareConfigForTipPose and the search. With exact, also restores the joints that moved by less than 0.0001,
+    // and spherical joints, i.e. leaves the environment as it was before prepareConfigForTipPose
+    if (!state.ikGroupWasActive)
+        ikGroup->setActive(false);
+
+    // Restore the IK element activation state:
+    for (size_t i=0;i<ikGroup->ikElements.size();i++)
+        ikGroup->ikElements[i]->setIsActive(state.enabledElements[i]);
+
+    // Restore joint modes/dependencies, then positions (dependent joints follow their master):
+    for (size_t i=0;i<state.sceneJoints.size();i++)
+    {
+        CJoint* aj=state.sceneJoints[i];
+        if (aj->getJointMode()!=state.initSceneJointModes[i])
+            aj->setJointMode(state.initSceneJointModes[i]);
+        if (aj->getDependencyJointHandle()!=state.initSceneJointDependencies[i])
+            aj->setDependencyJointHandle(state.initSceneJointDependencies[i]);
+        if (aj->getDependencyJointAdd()!=state.initSceneJointDependencyOffsets[i])
+            aj->setDependencyJointAdd(state.initSceneJointDependencyOffsets[i]);
+        if (aj->getDependencyJointMult()!=state.initSceneJointDependencyMults[i])
+            aj->setDependencyJointMult(state.initSceneJointDependencyMults[i]);
+    }
+    for (size_t i=0;i<state.sceneJoints.size();i++)
+    {
+        CJoint* aj=state.sceneJoints[i];
+        if ( exact||(fabs(aj->getPosition()-state.initSceneJointValues[i])>simReal(0.0001)) )
+            aj->setPosition(state.initSceneJointValues[i]);
+        if ( exact&&(aj->getJointType()==sim_joint_spherical_subtype) )
+            aj->setSphericalTransformation(state.initSceneJointQuaternions[i]);
+    }
+}
+
+struct SConfigForTipPoseTask
+{
+    int ikGroupHandle;
+    const std::vector<int>* jointHandles;
+    const int* jointOptions;
+    simReal thresholdDist;
+    int maxIterations;
+    const simReal* metric;
+    bool(*validationCallback)(simReal*);
+    const std::vector<simReal>* minVals;
+    const std::vector<simReal>* rangeVals;
+    unsigned long long seed;
+    std::atomic<int>* firstSuccess;
+    std::mutex* solutionMutex;
+    std::vector<simReal>* solution;
+};
+
+void getConfigForTipPoseWorker(void* data,size_t workerIndex,size_t workerCnt)
+{ // Works on its own copy of the environment (see CIkWorkerPool), and restores what it modified (see
+    // restoreConfigForTipPose), since the copy is reused by later calls. Sample i is drawn from
+    // a generator seeded with (seed,i), and the solution of the first successful sample is kept, i.e. the result does
+    // not depend on workerCnt or on timing
+    SConfigForTipPoseTask* task=static_cast<SConfigForTipPoseTask*>(data);
+    CikGroup* ikGroup=App::currentInstance->ikGroupContainer->getIkGroup(task->ikGroupHandle);
+    std::vector<CJoint*> joints;
+    for (size_t i=0;i<task->jointHandles->size();i++)
+        joints.push_back(App::currentInstance->objectContainer->getJoint(task->jointHandles->at(i)));
+    std::vector<CDummy*> tips;
+    std::vector<CDummy*> targets;
+    std::vector<CSceneObject*> bases;
+    getConfigForTipPoseFrames(ikGroup,tips,targets,bases);
+    SConfigForTipPoseState state;
+    prepareConfigForTipPose(ikGroup,joints,task->jointOptions,state);
+    std::vector<simReal> conf(joints.size());
+    for (int iterationCnt=int(workerIndex);iterationCnt<task->maxIterations;iterationCnt+=int(workerCnt))
+    {
+        if (iterationCnt>task->firstSuccess->load())
+            break;
+        unsigned long long rndState=task->seed^(0xD1B54A32D192ED03ULL*(unsigned long long)(iterationCnt+1));
+        for (size_t i=0;i<joints.size();i++)
+            conf[i]=task->minVals->at(i)+getSampleRandomValue(rndState)*task->rangeVals->at(i);
+        if (tryConfigForTipPose(ikGroup,joints,tips,targets,bases,task->metric,task->thresholdDist,task->validationCallback,conf))
+        {
+            std::lock_guard<std::mutex> lock(*task->solutionMutex);
+            if (iterationCnt<task->firstSuccess->load())
+            {
+                task->firstSuccess->store(iterationCnt);
+                task->solution[0]=conf;
+            }
+            break;
+        }
+    }
+    restoreConfigForTipPose(ikGroup,state,true);
+#ifdef IK_CHECK_WORKER_COPIES
+    // Later pooled calls (e.g. ikSolveIkGroupBatch) must find the copy as the source environment is:
+    for (size_t i=0;i<state.sceneJoints.size();i++)
+    {
+        CJoint* aj=state.sceneJoints[i];
+        assert(aj->getPosition()==state.initSceneJointValues[i]);
+        assert(aj->getJointMode()==state.initSceneJointModes[i]);
+        assert(aj->getDependencyJointHandle()==state.initSceneJointDependencies[i]);
+        assert(aj->getDependencyJointAdd()==state.initSceneJointDependencyOffsets[i]);
+        assert(aj->getDependencyJointMult()==state.initSceneJointDependencyMults[i]);
+    }
+    assert(ikGroup->getActive()==state.ikGroupWasActive);
+    for (size_t i=0;i<ikGroup->ikElements.size();i++)
+        assert(ikGroup->ikElements[i]->getIsActive()==state.enabledElements[i]);
+#endif
+}
+
+int ikGetConfigForTipPose(int ikGroupHandle,size_t jointCnt,const int* jointHandles,simReal thresholdDist,int maxIterations,simReal* retConfig,const simReal* metric/*=nullptr*/,bool(*validationCallback)(simReal*)/*=nullptr*/,const int* jointOptions/*=nullptr*/,const simReal* lowLimits/*=nullptr*/,const simReal* ranges/*=nullptr*/,size_t workerCnt/*=1*/,const unsigned int* seed/*=nullptr*/)
 {
     int retVal=-1;
     std::vector<simReal> conf(jointCnt);
-    if (hasLaunched())
+    if (hasLaunchedOutsideSceneEdit())
     {
         CikGroup* ikGroup=App::currentInstance->ikGroupContainer->getIkGroup(ikGroupHandle);
         if (ikGroup!=nullptr)
@@ -1271,134 +1927,66 @@ int ikGetConfigForTipPose(int ikGroupHandle,size_t jointCnt,const int* jointHand
             std::vector<CDummy*> tips;
             std::vector<CDummy*> targets;
             std::vector<CSceneObject*> bases;
-            if (ikGroup!=nullptr)
-            {
-                if (ikGroup->ikElements.size()>0)
-                {
-                    for (size_t i=0;i<ikGroup->ikElements.size();i++)
-                    {
-                        CDummy* tip=App::currentInstance->objectContainer->getDummy(ikGroup->ikElements[i]->getTipHandle());
-                        CDummy* target=App::currentInstance->objectContainer->getDummy(ikGroup->ikElements[i]->getTargetHandle());
-                        CSceneObject* base=nullptr;
-                        if (ikGroup->ikElements[i]->getAltBaseHandleForConstraints()!=-1)
-                            base=App::currentInstance->objectContainer->getObject(ikGroup->ikElements[i]->getAltBaseHandleForConstraints());
-                        else
-                            base=App::currentInstance->objectContainer->getObject(ikGroup->ikElements[i]->getBaseHandle());
-                        if ((tip==nullptr)||(target==nullptr))
-                            err=2;
-                        tips.push_back(tip);
-                        targets.push_back(target);
-                        bases.push_back(base);
-                    }
-                }
-                else
-                    err=3;
-            }
+            int frameErr=getConfigForTipPoseFrames(ikGroup,tips,targets,bases);
+            if (frameErr!=0)
+                err=frameErr;
 
             if (err==0)
             {
                 retVal=0;
-                // Save joint positions/modes (all of them, just in case)
-                std::vector<CJoint*> sceneJoints;
-                std::vector<simReal> initSceneJointValues;
-                std::vector<int> initSceneJointModes;
-                for (size_t i=0;i<App::currentInstance->objectContainer->jointList.size();i++)
-                {
-                    CJoint* aj=App::currentInstance->objectContainer->getJoint(App::currentInstance->objectContainer->jointList[i]);
-                    sceneJoints.push_back(aj);
-                    initSceneJointValues.push_back(aj->getPosition());
-                    initSceneJointModes.push_back(aj->getJointMode());
-                }
-
-                ikGroup->setAllInvolvedJointsToPassiveMode();
-
-                bool ikGroupWasActive=ikGroup->getActive();
-                if (!ikGroupWasActive)
-                    ikGroup->setActive(true);
-
-                // It can happen that some IK elements get deactivated when the user provided wrong handles, so save the activation state:
-                std::vector<bool> enabledElements;
-                for (size_t i=0;i<ikGroup->ikElements.size();i++)
-                    enabledElements.push_back(ikGroup->ikElements[i]->getIsActive());
-
-                // Set the correct mode for the joints involved:
-                for (size_t i=0;i<jointCnt;i++)
-                {
-                    if ( (jointOptions==nullptr)||((jointOptions[i]&1)==0) )
-                        joints[i]->setJointMode(sim_jointmode_ik);
-                    else
-                        joints[i]->setJointMode(sim_jointmode_dependent);
-                }
-
-                // do the calculation:
-                for (int iterationCnt=0;iterationCnt<maxIterations;iterationCnt++)
-                {
-                    // 1. Pick a random state:
-                    for (size_t i=0;i<jointCnt;i++)
-                        joints[i]->setPosition(minVals[i]+(rand()/simReal(RAND_MAX))*rangeVals[i]);
-
-                    // 2. Check distances between tip and target pairs (there might be several pairs!):
-                    simReal cumulatedDist=simZero;
-                    for (size_t el=0;el<ikGroup->ikElements.size();el++)
+                if ( (workerCnt==1)&&(seed==nullptr) )
+                { // do the calculation in this environment:
+                    App::currentInstance->announceChanged();
+                    SConfigForTipPoseState state;
+                    prepareConfigForTipPose(ikGroup,joints,jointOptions,state);
+                    for (int iterationCnt=0;iterationCnt<maxIterations;iterationCnt++)
                     {
-                        C7Vector tipTr(tips[el]->getCumulativeTransformation());
-                        C7Vector targetTr(targets[el]->getCumulativeTransformation());
-                        C7Vector relTrInv(C7Vector::identityTransformation);
-                        if (bases[el]!=nullptr)
-                            relTrInv=bases[el]->getCumulativeTransformationPart1().getInverse();
-                        tipTr=relTrInv*tipTr;
-                        targetTr=relTrInv*targetTr;
-                        C3Vector dx(tipTr.X-targetTr.X);
-                        dx(0)*=theMetric[0];
-                        dx(1)*=theMetric[1];
-                        dx(2)*=theMetric[2];
-                        simReal angle=tipTr.Q.getAngleBetweenQuaternions(targetTr.Q)*theMetric[3];
-                        cumulatedDist+=sqrt(dx(0)*dx(0)+dx(1)*dx(1)+dx(2)*dx(2)+angle*angle);
-                    }
-
-                    // 3. If distance<=threshold, try to perform IK:
-                    if (cumulatedDist<=thresholdDist)
-                    {
-                        if (sim_ikresult_success==ikGroup->computeGroupIk(true))
-                        { // 3.1 We found a configuration that works!
-                            // 3.2 Check joint limits:
-                            bool limitsOk=true;
-                            if ( (lowLimits!=nullptr)&&(ranges!=nullptr) )
-                            {
-                                for (size_t i=0;i<jointCnt;i++)
-                                {
-                                    if ( (joints[i]->getPosition()<minVals[i])||(joints[i]->getPosition()>minVals[i]+rangeVals[i]) )
-                                        limitsOk=false;
-                                }
-                            }
-                            // 3.3 Finally check if the callback accepts that configuration:
+                        // Pick a random state:
+                        for (size_t i=0;i<jointCnt;i++)
+                            conf[i]=minVals[i]+(rand()/simReal(RAND_MAX))*rangeVals[i];
+                        if (tryConfigForTipPose(ikGroup,joints,tips,targets,bases,theMetric,thresholdDist,validationCallback,conf))
+                        {
                             for (size_t i=0;i<jointCnt;i++)
-                                conf[i]=joints[i]->getPosition();
-                            if ( (validationCallback==nullptr)||validationCallback(&conf[0]) )
-                            {
-                                for (size_t i=0;i<jointCnt;i++)
-                                    retConfig[i]=conf[i];
-                                retVal=1;
-                                break;
-                            }
+                                retConfig[i]=conf[i];
+                            retVal=1;
+                            break;
                         }
                     }
+                    restoreConfigForTipPose(ikGroup,state,false);
                 }
-
-                if (!ikGroupWasActive)
-                    ikGroup->setActive(false);
-
-                // Restore the IK element activation state:
-                for (size_t i=0;i<ikGroup->ikElements.size();i++)
-                    ikGroup->ikElements[i]->setIsActive(enabledElements[i]);
-
-                // Restore joint positions/modes:
-                for (size_t i=0;i<sceneJoints.size();i++)
-                {
-                    if (fabs(sceneJoints[i]->getPosition()-initSceneJointValues[i])>simReal(0.0001))
-                        sceneJoints[i]->setPosition(initSceneJointValues[i]);
-                    if (sceneJoints[i]->getJointMode()!=initSceneJointModes[i])
-                        sceneJoints[i]->setJointMode(initSceneJointModes[i]);
+                else
+                { // do the calculation with several workers, each with its own copy of the environment, that is kept for the next call:
+                    if (workerCnt==0)
+                        workerCnt=std::max<size_t>(1,std::thread::hardware_concurrency());
+                    unsigned long long theSeed;
+                    if (seed!=nullptr)
+                        theSeed=seed[0];
+                    else
+                        theSeed=(unsigned long long)(rand());
+                    std::vector<int> handles(jointHandles,jointHandles+jointCnt);
+                    std::atomic<int> firstSuccess(maxIterations);
+                    std::mutex solutionMutex;
+                    SConfigForTipPoseTask task;
+                    task.ikGroupHandle=ikGroupHandle;
+                    task.jointHandles=&handles;
+                    task.jointOptions=jointOptions;
+                    task.thresholdDist=thresholdDist;
+                    task.maxIterations=maxIterations;
+                    task.metric=theMetric;
+                    task.validationCallback=validationCallback;
+                    task.minVals=&minVals;
+                    task.rangeVals=&rangeVals;
+                    task.seed=theSeed;
+                    task.firstSuccess=&firstSuccess;
+                    task.solutionMutex=&solutionMutex;
+                    task.solution=&conf;
+                    App::currentInstance->workerPool.run(workerCnt,getConfigForTipPoseWorker,&task);
+                    if (firstSuccess.load()<maxIterations)
+                    {
+                        for (size_t i=0;i<jointCnt;i++)
+                            retConfig[i]=conf[i];
+                        retVal=1;
+                    }
                 }
             }
             else
@@ -1418,11 +2006,160 @@ int ikGetConfigForTipPose(int ikGroupHandle,size_t jointCnt,const int* jointHand
 }
 
 int _getLoadingMapping(const std::vector<int>* map,int oldVal)
-{
-    for (size_t i=0;i<map->size()/2;i++)
+{ // map was prepared with CObjectContainer::prepareFastLoadingMapping
+    const std::vector<int>& m=map[0];
+    if (m.size()<2)
+        return(-1);
+    if (m[0]==IK_LOADING_MAPPING_DENSE)
+    { // m[1] is the lowest old handle, followed by the new handles
+        long long index=(long long)oldVal-(long long)m[1];
+        if ( (index<0)||(index>=(long long)(m.size()-2)) )
+            return(-1);
+        return(m[size_t(index)+2]);
+    }
+    // Sorted (old handle,new handle) pairs after m[0]:
+    size_t low=0;
+    size_t high=(m.size()-1)/2;
+    while (low<high)
     {
-        if (oldVal==map->at(2*i+0))
-            return(map->at(2*i+1));
+        size_t mid=(low+high)/2;
+        if (m[1+2*mid]<oldVal)
+            low=mid+1;
+        else
+            high=mid;
     }
+    if ( (low<(m.size()-1)/2)&&(m[1+2*low]==oldVal) )
+        return(m[2+2*low]);
     return(-1);
 }
+
+bool ikCreateModel(int* modelHandle)
+{ // Snapshot of the current environment, that later changes to the environment do not affect
+    bool retVal=false;
+    if (hasLaunchedOutsideSceneEdit())
+    {
+        int h=CikModel::addModel(new CikModel(App::currentInstance));
+        if (modelHandle!=nullptr)
+            modelHandle[0]=h;
+        retVal=true;
+    }
+    return(retVal);
+}
+
+bool ikEraseModel(int modelHandle)
+{
+    bool retVal=false;
+    if (CikModel::removeModel(modelHandle))
+        retVal=true;
+    else
+        lastError="Invalid model handle";
+    return(retVal);
+}
+
+bool ikGetModelStateSize(int modelHandle,size_t* stateSize)
+{
+    bool retVal=false;
+    CikModel* model=CikModel::getModel(modelHandle);
+    if (model!=nullptr)
+    {
+        stateSize[0]=model->getStateSize();
+        retVal=true;
+    }
+    else
+        lastError="Invalid model handle";
+    return(retVal);
+}
+
+bool ikGetModelStateIndex(int modelHandle,int objectHandle,size_t* stateIndex)
+{
+    bool retVal=false;
+    CikModel* model=CikModel::getModel(modelHandle);
+    if (model!=nullptr)
+    {
+        int index=model->getStateIndex(objectHandle);
+        if (index>=0)
+        {
+            stateIndex[0]=size_t(index);
+            retVal=true;
+        }
+        else
+            lastError="Object is not part of the model state";
+    }
+    else
+        lastError="Invalid model handle";
+    return(retVal);
+}
+
+bool ikGetModelInitialState(int modelHandle,simReal* state)
+{
+    bool retVal=false;
+    CikModel* model=CikModel::getModel(modelHandle);
+    if (model!=nullptr)
+    {
+        model->getInitialState(state);
+        retVal=true;
+    }
+    else
+        lastError="Invalid model handle";
+    return(retVal);
+}
+
+App* beginModelUse(CikModel* model,const simReal* state)
+{ // Makes a scratch copy of the model with that state the current environment of the calling thread
+    App* previous=App::currentInstance;
+    App::currentInstance=model->acquireEnvironment();
+    model->writeState(state);
+    return(previous);
+}
+
+void endModelUse(CikModel* model,App* previous)
+{
+    model->releaseEnvironment(App::currentInstance);
+    App::currentInstance=previous;
+}
+
+bool ikGetModelObjectTransformation(int modelHandle,const simReal* state,int objectHandle,int relativeToObjectHandle,C7Vector* transf)
+{
+    bool retVal=false;
+    CikModel* model=CikModel::getModel(modelHandle);
+    if (model!=nullptr)
+    {
+        App* previous=beginModelUse(model,state);
+        retVal=getObjectTransformation(objectHandle,relativeToObjectHandle,transf);
+        endModelUse(model,previous);
+    }
+    else
+        lastError="Invalid model handle";
+    return(retVal);
+}
+
+bool ikHandleModelIkGroup(int modelHandle,simReal* state,int ikGroupHandle,int* result/*=nullptr*/)
+{ // Like ikHandleIkGroup, but with the joint values of the state, that are updated
+    bool retVal=false;
+    CikModel* model=CikModel::getModel(modelHandle);
+    if (model!=nullptr)
+    {
+        App* previous=beginModelUse(model,state);
+        retVal=handleIkGroup(ikGroupHandle,result,1);
+        model->readState(state);
+        endModelUse(model,previous);
+    }
+    else
+        lastError="Invalid model handle";
+    return(retVal);
+}
+
+bool ikSolveModelIkGroup(int modelHandle,int ikGroupHandle,size_t jointCnt,const int* jointHandles,const simReal* initialJointValues,const C7Vector* targetPoses,simReal* jointValues,int* result/*=nullptr*/,simReal* residuals/*=nullptr*/,int* iterations/*=nullptr*/)
+{ // Like ikSolveIkGroup, on the model with its initial state
+    bool retVal=false;
+    CikModel* model=CikModel::getModel(modelHandle);
+    if (model!=nullptr)
+    {
+        App* previous=beginModelUse(model,model->getInitialStateData());
+        retVal=solveIkGroup(ikGroupHandle,jointCnt,jointHandles,initialJointValues,targetPoses,jointValues,result,residuals,iterations);
+        endModelUse(model,previous);
+    }
+    else
+        lastError="Invalid model handle";
+    return(retVal);
+}
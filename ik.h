@@ -14,14 +14,30 @@ const simReal IK_DIVISION_FACTOR=simReal(100.0);
 #define SIM_IS_BIT_SET(var,bit) (((var) & (1<<(bit)))!=0)
 #define ik_handleflag_tipframe 0x00400000
 
+#define IK_LOADING_MAPPING_DENSE 0
+#define IK_LOADING_MAPPING_SORTED 1
 int _getLoadingMapping(const std::vector<int>* map,int oldVal);
 
 std::string ikGetLastError();
 bool ikCreateEnvironment(int* environmentHandle=nullptr,bool protectedEnvironment=false);
 bool ikLoad(const unsigned char* data,size_t dataLength);
+bool ikLoadFile(const char* path);
+unsigned char* ikSave(size_t* dataLength);
 bool ikSwitchEnvironment(int handle,bool allowAlsoProtectedEnvironment=false);
+bool ikDuplicateEnvironment(int environmentHandle,int* newEnvironmentHandle=nullptr);
 bool ikEraseEnvironment(int* switchedEnvironmentHandle=nullptr);
 void ikReleaseBuffer(void* buffer);
+bool ikBeginSceneEdit();
+bool ikEndSceneEdit();
+
+bool ikCreateModel(int* modelHandle);
+bool ikEraseModel(int modelHandle);
+bool ikGetModelStateSize(int modelHandle,size_t* stateSize);
+bool ikGetModelStateIndex(int modelHandle,int objectHandle,size_t* stateIndex);
+bool ikGetModelInitialState(int modelHandle,simReal* state);
+bool ikGetModelObjectTransformation(int modelHandle,const simReal* state,int objectHandle,int relativeToObjectHandle,C7Vector* transf);
+bool ikHandleModelIkGroup(int modelHandle,simReal* state,int ikGroupHandle,int* result=nullptr);
+bool ikSolveModelIkGroup(int modelHandle,int ikGroupHandle,size_t jointCnt,const int* jointHandles,const simReal* initialJointValues,const C7Vector* targetPoses,simReal* jointValues,int* result=nullptr,simReal* residuals=nullptr,int* iterations=nullptr);
 
 bool ikGetObjectHandle(const char* objectName,int* objectHandle);
 bool ikDoesObjectExist(const char* objectName);
@@ -76,14 +92,18 @@ bool ikSetIkElementPrecision(int ikGroupHandle,int ikElementIndex,simReal linear
 bool ikGetIkElementWeights(int ikGroupHandle,int ikElementIndex,simReal* linearWeight,simReal* angularWeight);
 bool ikSetIkElementWeights(int ikGroupHandle,int ikElementIndex,simReal linearWeight,simReal angularWeight);
 
-bool ikHandleIkGroup(int ikGroupHandle,int* result=nullptr);
+bool ikHandleIkGroup(int ikGroupHandle,int* result=nullptr,size_t workerCnt=1);
+bool ikSolveIkGroup(int ikGroupHandle,size_t jointCnt,const int* jointHandles,const simReal* initialJointValues,const C7Vector* targetPoses,simReal* jointValues,int* result=nullptr,simReal* residuals=nullptr,int* iterations=nullptr);
+bool ikSolveIkGroupBatch(int ikGroupHandle,size_t jointCnt,const int* jointHandles,size_t sampleCnt,const C7Vector* targetPoses,size_t seedCnt,const simReal* seeds,simReal* jointValues,int* results=nullptr,size_t workerCnt=1);
 bool ikComputeJacobian(int ikGroupHandle,int options,bool* success=nullptr);
 simReal* ikGetJacobian(int ikGroupHandle,size_t* matrixSize);
 bool ikGetManipulability(int ikGroupHandle,simReal* manip);
 
-int ikGetConfigForTipPose(int ikGroupHandle,size_t jointCnt,const int* jointHandles,simReal thresholdDist,int maxIterations,simReal* retConfig,const simReal* metric=nullptr,bool(*validationCallback)(simReal*)=nullptr,const int* jointOptions=nullptr,const simReal* lowLimits=nullptr,const simReal* ranges=nullptr);
+int ikGetConfigForTipPose(int ikGroupHandle,size_t jointCnt,const int* jointHandles,simReal thresholdDist,int maxIterations,simReal* retConfig,const simReal* metric=nullptr,bool(*validationCallback)(simReal*)=nullptr,const int* jointOptions=nullptr,const simReal* lowLimits=nullptr,const simReal* ranges=nullptr,size_t workerCnt=1,const unsigned int* seed=nullptr);
 
 bool ikGetObjectTransformation(int objectHandle,int relativeToObjectHandle,C7Vector* transf);
 bool ikSetObjectTransformation(int objectHandle,int relativeToObjectHandle,const C7Vector* transf);
 bool ikGetObjectMatrix(int objectHandle,int relativeToObjectHandle,C4X4Matrix* matrix);
+bool ikComputePosesBatch(size_t frameCnt,const int* frameHandles,size_t jointCnt,const int* jointHandles,size_t configCnt,const simReal* configs,C7Vector* poses);
+bool ikComputeTipPosesBatch(int ikGroupHandle,size_t jointCnt,const int* jointHandles,size_t configCnt,const simReal* configs,C7Vector* tipPoses);
 bool ikSetObjectMatrix(int objectHandle,int relativeToObjectHandle,const C4X4Matrix* matrix);
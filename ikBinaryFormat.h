@@ -0,0 +1,110 @@
+#pragma once
+
+#include "ik.h"
+
+// Binary format written by ikSave, and read by ikLoad next to the format exported by CoppeliaSim. Native byte order:
+//  - header: IK_BINARY_HEADER_INTS ints, starting with IK_BINARY_FORMAT_MAGIC
+//  - object records: objectCnt times (IK_OBJECT_RECORD_INTS ints, then IK_OBJECT_RECORD_REALS reals), joints and dummies alike
+//  - IK group records: ikGroupCnt times (IK_GROUP_RECORD_INTS ints, then IK_GROUP_RECORD_REALS reals)
+//  - IK element records: elementCnt times (IK_ELEMENT_RECORD_INTS ints, then IK_ELEMENT_RECORD_REALS reals), by group
+//  - string table: zero-terminated names, that records refer to with their offset in the table
+// Reals are 4 or 8 bytes, as specified in the header. All records of a kind have the same size, so that the position of
+// any record and of the string table follow from the header. Handles are the ones of the saved environment.
+
+#define IK_BINARY_FORMAT_MAGIC 0x46424b49 // "IKBF"
+#define IK_BINARY_FORMAT_VERSION 1
+
+enum { // header
+    IK_BINARY_HEADER_MAGIC=0,
+    IK_BINARY_HEADER_VERSION,
+    IK_BINARY_HEADER_REAL_SIZE,
+    IK_BINARY_HEADER_OBJECT_CNT,
+    IK_BINARY_HEADER_IKGROUP_CNT,
+    IK_BINARY_HEADER_IKELEMENT_CNT,
+    IK_BINARY_HEADER_STRING_TABLE_SIZE,
+    IK_BINARY_HEADER_INTS
+};
+
+enum { // SIkObjectRecord::ints
+    IK_OBJECT_TYPE=0,
+    IK_OBJECT_HANDLE,
+    IK_OBJECT_PARENT_HANDLE,
+    IK_OBJECT_NAME,
+    IK_OBJECT_JOINT_TYPE,
+    IK_OBJECT_JOINT_FLAGS,             // bit0: cyclic
+    IK_OBJECT_JOINT_MODE,
+    IK_OBJECT_JOINT_DEPENDENCY_HANDLE,
+    IK_OBJECT_DUMMY_LINKED_HANDLE,
+    IK_OBJECT_DUMMY_LINK_TYPE,
+    IK_OBJECT_RECORD_INTS
+};
+
+enum { // SIkObjectRecord::reals
+    IK_OBJECT_TRANSFORMATION=0,         // quaternion, then position
+    IK_OBJECT_JOINT_SCREW_PITCH=7,
+    IK_OBJECT_JOINT_SPHERICAL_QUATERNION,
+    IK_OBJECT_JOINT_MIN_POSITION=12,
+    IK_OBJECT_JOINT_POSITION_RANGE,
+    IK_OBJECT_JOINT_POSITION,
+    IK_OBJECT_JOINT_MAX_STEP_SIZE,
+    IK_OBJECT_JOINT_IK_WEIGHT,
+    IK_OBJECT_JOINT_DEPENDENCY_MULT,
+    IK_OBJECT_JOINT_DEPENDENCY_ADD,
+    IK_OBJECT_RECORD_REALS
+};
+
+enum { // SIkGroupRecord::ints
+    IK_GROUP_HANDLE=0,
+    IK_GROUP_NAME,
+    IK_GROUP_MAX_ITERATIONS,
+    IK_GROUP_CONSTRAINTS,
+    IK_GROUP_CALCULATION_METHOD,
+    IK_GROUP_DO_ON_FAIL_OR_SUCCESS_OF,
+    IK_GROUP_FLAGS,                     // same bits as in the CoppeliaSim export, then bit8: correct joint limits
+    IK_GROUP_ELEMENT_CNT,
+    IK_GROUP_RECORD_INTS
+};
+
+enum { // SIkGroupRecord::reals
+    IK_GROUP_JOINT_LIMIT_WEIGHT=0,
+    IK_GROUP_JOINT_THRESHOLD_ANGULAR,
+    IK_GROUP_JOINT_THRESHOLD_LINEAR,
+    IK_GROUP_DLS_FACTOR,
+    IK_GROUP_RECORD_REALS
+};
+
+enum { // SIkElementRecord::ints
+    IK_ELEMENT_HANDLE=0,
+    IK_ELEMENT_TIP_HANDLE,
+    IK_ELEMENT_BASE_HANDLE,
+    IK_ELEMENT_ALT_BASE_HANDLE,
+    IK_ELEMENT_CONSTRAINTS,
+    IK_ELEMENT_ACTIVE,
+    IK_ELEMENT_RECORD_INTS
+};
+
+enum { // SIkElementRecord::reals
+    IK_ELEMENT_MIN_ANGULAR_PRECISION=0,
+    IK_ELEMENT_MIN_LINEAR_PRECISION,
+    IK_ELEMENT_POSITION_WEIGHT,
+    IK_ELEMENT_ORIENTATION_WEIGHT,
+    IK_ELEMENT_RECORD_REALS
+};
+
+struct SIkObjectRecord
+{
+    int ints[IK_OBJECT_RECORD_INTS];
+    simReal reals[IK_OBJECT_RECORD_REALS];
+};
+
+struct SIkGroupRecord
+{
+    int ints[IK_GROUP_RECORD_INTS];
+    simReal reals[IK_GROUP_RECORD_REALS];
+};
+
+struct SIkElementRecord
+{
+    int ints[IK_ELEMENT_RECORD_INTS];
+    simReal reals[IK_ELEMENT_RECORD_REALS];
+};
@@ -0,0 +1,77 @@
+#include "simConst.h"
+#include "ikChainPlan.h"
+#include "app.h"
+
+CikChainPlan::CikChainPlan()
+{
+    tip=nullptr;
+    base=nullptr;
+    baseOk=false;
+    doF=0;
+    version=0;
+    buildCount=0;
+}
+
+CikChainPlan::~CikChainPlan()
+{
+}
+
+void CikChainPlan::invalidate()
+{
+    version=0;
+}
+
+void CikChainPlan::build(int tipHandle,int baseHandle,unsigned int topologyVersion)
+{ // Walks the parent chain once. The plan stays valid until the topology or a joint mode changes
+    stepObjects.clear();
+    stepJoints.clear();
+    stepStages.clear();
+    stepColumns.clear();
+    rowJointHandles.clear();
+    rowJointStages.clear();
+    chainJoints.clear();
+    doF=0;
+    version=topologyVersion;
+    buildCount++;
+    tip=App::currentInstance->objectContainer->getDummy(tipHandle);
+    base=App::currentInstance->objectContainer->getObject(baseHandle);
+    baseOk=false;
+    if (tip!=nullptr)
+    {
+        CSceneObject* iterat=tip;
+        while ( (iterat!=base)&&(iterat!=nullptr) )
+        {
+            bool ikJoint=false;
+            if (iterat->getObjectType()==sim_object_joint_type)
+            {
+                CJoint* joint=static_cast<CJoint*>(iterat);
+                chainJoints.push_back(joint);
+                int mode=joint->getJointMode();
+                ikJoint=( (mode==sim_jointmode_ik)||(mode==sim_jointmode_reserved_previously_ikdependent)||(mode==sim_jointmode_dependent) );
+                if (ikJoint)
+                {
+                    size_t d=joint->getDoFs();
+                    for (int i=int(d-1);i>=0;i--)
+                    {
+                        stepObjects.push_back(iterat);
+                        stepJoints.push_back(joint);
+                        stepStages.push_back(size_t(i));
+                        stepColumns.push_back(doF);
+                        rowJointHandles.push_back(joint->getObjectHandle());
+                        rowJointStages.push_back(size_t(i));
+                        doF++;
+                    }
+                }
+            }
+            if (!ikJoint)
+            {
+                stepObjects.push_back(iterat);
+                stepJoints.push_back(nullptr);
+                stepStages.push_back(0);
+                stepColumns.push_back(0);
+            }
+            iterat=iterat->getParentObject();
+        }
+        baseOk=(iterat==base);
+    }
+}
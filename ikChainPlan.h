@@ -0,0 +1,38 @@
+#pragma once
+
+#include "ik.h"
+#include <vector>
+
+class CSceneObject;
+class CJoint;
+class CDummy;
+
+class CikChainPlan
+{
+public:
+    CikChainPlan();
+    virtual ~CikChainPlan();
+
+    void build(int tipHandle,int baseHandle,unsigned int topologyVersion);
+    void invalidate();
+
+    // The objects from the tip (included) to the base (excluded), one step per object, except for
+    // spherical IK joints that have one step per stage (stage 2, then 1, then 0):
+    std::vector<CSceneObject*> stepObjects;
+    std::vector<CJoint*> stepJoints;    // nullptr if the step is not an IK joint (i.e. not in ik or dependent mode)
+    std::vector<size_t> stepStages;
+    std::vector<size_t> stepColumns;    // Jacobian column of the step, if stepJoints is not nullptr
+
+    // Jacobian column layout, from tip to base:
+    std::vector<int> rowJointHandles;
+    std::vector<size_t> rowJointStages;
+
+    std::vector<CJoint*> chainJoints;   // all joints between tip and base, whatever their mode
+
+    CDummy* tip;
+    CSceneObject* base;
+    bool baseOk;                        // base is nullptr or a parent of tip
+    size_t doF;                         // doF==0 means there is no IK joint between tip and base
+    unsigned int version;               // topology version the plan was built for. 0 means invalid
+    unsigned int buildCount;            // incremented with each build, lets users of the plan detect a rebuild
+};
@@ -2,6 +2,7 @@
 #include "ikElement.h"
 #include "ikRoutines.h"
 #include "app.h"
+#include "ikKernels.h"
 
 CikElement::CikElement(int theTooltip)
 {
@@ -19,6 +20,8 @@ CikElement::CikElement(int theTooltip)
     errorVector=nullptr;
     rowJointHandles=nullptr;
     rowJointStages=nullptr;
+    _jacobian=nullptr;
+    _targetPoseOverride=nullptr;
 }
 
 CikElement::~CikElement()
@@ -26,6 +29,21 @@ CikElement::~CikElement()
     clearIkEquations();
 }
 
+CikElement* CikElement::copyYourself() const
+{ // Equations, Jacobian buffers and chain plan are not copied
+    CikElement* newElement=new CikElement(_tipHandle);
+    newElement->_ikElementHandle=_ikElementHandle;
+    newElement->_baseHandle=_baseHandle;
+    newElement->_altBaseHandleForConstraints=_altBaseHandleForConstraints;
+    newElement->_constraints=_constraints;
+    newElement->_isActive=_isActive;
+    newElement->_positionWeight=_positionWeight;
+    newElement->_orientationWeight=_orientationWeight;
+    newElement->_minAngularPrecision=_minAngularPrecision;
+    newElement->_minLinearPrecision=_minLinearPrecision;
+    return(newElement);
+}
+
 bool CikElement::announceSceneObjectWillBeErased(int objectHandle)
 {
     bool retVal=( (_baseHandle==objectHandle)||(_altBaseHandleForConstraints==objectHandle)||(_tipHandle==objectHandle) );
@@ -37,6 +55,7 @@ void CikElement::performSceneObjectLoadingMapping(const std::vector<int>* map)
     _tipHandle=_getLoadingMapping(map,_tipHandle);
     _baseHandle=_getLoadingMapping(map,_baseHandle);
     _altBaseHandleForConstraints=_getLoadingMapping(map,_altBaseHandleForConstraints);
+    _chainPlan.invalidate();
 }
 
 void CikElement::serialize(CSerialization& ar)
@@ -51,6 +70,36 @@ void CikElement::serialize(CSerialization& ar)
     _positionWeight=simReal(ar.readFloat());
     _orientationWeight=simReal(ar.readFloat());
     _isActive=(ar.readByte()&1);
+    _chainPlan.invalidate();
+}
+
+void CikElement::writeRecord(SIkElementRecord& rec) const
+{
+    rec.ints[IK_ELEMENT_HANDLE]=_ikElementHandle;
+    rec.ints[IK_ELEMENT_TIP_HANDLE]=_tipHandle;
+    rec.ints[IK_ELEMENT_BASE_HANDLE]=_baseHandle;
+    rec.ints[IK_ELEMENT_ALT_BASE_HANDLE]=_altBaseHandleForConstraints;
+    rec.ints[IK_ELEMENT_CONSTRAINTS]=_constraints;
+    rec.ints[IK_ELEMENT_ACTIVE]=(_isActive?1:0);
+    rec.reals[IK_ELEMENT_MIN_ANGULAR_PRECISION]=_minAngularPrecision;
+    rec.reals[IK_ELEMENT_MIN_LINEAR_PRECISION]=_minLinearPrecision;
+    rec.reals[IK_ELEMENT_POSITION_WEIGHT]=_positionWeight;
+    rec.reals[IK_ELEMENT_ORIENTATION_WEIGHT]=_orientationWeight;
+}
+
+void CikElement::readRecord(const SIkElementRecord& rec)
+{
+    _ikElementHandle=rec.ints[IK_ELEMENT_HANDLE];
+    _tipHandle=rec.ints[IK_ELEMENT_TIP_HANDLE];
+    _baseHandle=rec.ints[IK_ELEMENT_BASE_HANDLE];
+    _altBaseHandleForConstraints=rec.ints[IK_ELEMENT_ALT_BASE_HANDLE];
+    _constraints=rec.ints[IK_ELEMENT_CONSTRAINTS];
+    _isActive=(rec.ints[IK_ELEMENT_ACTIVE]&1);
+    _minAngularPrecision=rec.reals[IK_ELEMENT_MIN_ANGULAR_PRECISION];
+    _minLinearPrecision=rec.reals[IK_ELEMENT_MIN_LINEAR_PRECISION];
+    _positionWeight=rec.reals[IK_ELEMENT_POSITION_WEIGHT];
+    _orientationWeight=rec.reals[IK_ELEMENT_ORIENTATION_WEIGHT];
+    _chainPlan.invalidate();
 }
 
 int CikElement::getIkElementHandle() const
@@ -84,6 +133,7 @@ int CikElement::getBaseHandle() const
 void CikElement::setBaseHandle(int newBaseHandle)
 {
     _baseHandle=newBaseHandle;
+    _chainPlan.invalidate();
 }
 
 int CikElement::getAltBaseHandleForConstraints() const
@@ -122,6 +172,14 @@ void CikElement::setIsActive(bool isActive)
     _isActive=isActive;
 }
 
+const CikChainPlan* CikElement::getChainPlan()
+{ // The plan is only rebuilt if the tip/base handles, the scene topology or a joint mode changed
+    unsigned int topologyVersion=App::currentInstance->objectContainer->getTopologyVersion();
+    if (_chainPlan.version!=topologyVersion)
+        _chainPlan.build(_tipHandle,_baseHandle,topologyVersion);
+    return(&_chainPlan);
+}
+
 simReal CikElement::getMinLinearPrecision() const
 {
     return(_minLinearPrecision);
@@ -176,23 +234,9 @@ void CikElement::isWithinTolerance(bool& position,bool& orientation,bool useTemp
 {
     position=true;
     orientation=true;
-    CDummy* targetObject=App::currentInstance->objectContainer->getDummy(getTargetHandle());
-    if (targetObject!=nullptr)
+    simReal linAndAngErrors[2];
+    if (getTipTargetErrors(linAndAngErrors,useTempValues))
     {
-        C7Vector targetTr(targetObject->getCumulativeTransformationPart1(useTempValues));
-        CDummy* tooltipObject=App::currentInstance->objectContainer->getDummy(_tipHandle);
-        C7Vector tooltipTr(tooltipObject->getCumulativeTransformationPart1(useTempValues));
-        C7Vector baseTrInv(C7Vector::identityTransformation);
-        CDummy* baseObject=App::currentInstance->objectContainer->getDummy(_baseHandle);
-        if (baseObject!=nullptr)
-            baseTrInv=baseObject->getCumulativeTransformationPart1(useTempValues).getInverse();
-        CDummy* altBaseObject=App::currentInstance->objectContainer->getDummy(_altBaseHandleForConstraints);
-        if (altBaseObject!=nullptr)
-            baseTrInv=altBaseObject->getCumulativeTransformationPart1(useTempValues).getInverse();
-        tooltipTr=baseTrInv*tooltipTr;
-        targetTr=baseTrInv*targetTr;
-        simReal linAndAngErrors[2];
-        _getMatrixError(targetTr.getMatrix(),tooltipTr.getMatrix(),linAndAngErrors);
         if ( (_constraints&(sim_ik_x_constraint|sim_ik_y_constraint|sim_ik_z_constraint))!=0 )
         {
             if (_minLinearPrecision<linAndAngErrors[0])
@@ -206,29 +250,88 @@ void CikElement::isWithinTolerance(bool& position,bool& orientation,bool useTemp
     }
 }
 
-void CikElement::prepareEquations(simReal interpolationFactor)
+bool CikElement::getTipTargetErrors(simReal linAndAngErrors[2],bool useTempValues) const
+{ // Linear and angular error between tip and target, for the constrained components only. False if there is no target
+    bool retVal=false;
+    C7Vector targetTr;
+    if (_getTargetTransformation(targetTr,useTempValues))
+    {
+        CDummy* tooltipObject=App::currentInstance->objectContainer->getDummy(_tipHandle);
+        C7Vector tooltipTr(tooltipObject->getCumulativeTransformationPart1(useTempValues));
+        C7Vector baseTrInv(C7Vector::identityTransformation);
+        CDummy* baseObject=App::currentInstance->objectContainer->getDummy(_baseHandle);
+        if (baseObject!=nullptr)
+            baseTrInv=CIkKernels::getInverse(baseObject->getCumulativeTransformationPart1(useTempValues));
+        CDummy* altBaseObject=App::currentInstance->objectContainer->getDummy(_altBaseHandleForConstraints);
+        if (altBaseObject!=nullptr)
+            baseTrInv=CIkKernels::getInverse(altBaseObject->getCumulativeTransformationPart1(useTempValues));
+        tooltipTr=CIkKernels::multiply(baseTrInv,tooltipTr);
+        targetTr=CIkKernels::multiply(baseTrInv,targetTr);
+        _getMatrixError(targetTr.getMatrix(),tooltipTr.getMatrix(),linAndAngErrors);
+        retVal=true;
+    }
+    return(retVal);
+}
+
+void CikElement::setTargetPoseOverride(const C7Vector* pose)
 {
+    _targetPoseOverride=pose;
+}
+
+bool CikElement::_getTargetTransformation(C7Vector& tr,bool useTempValues) const
+{ // Absolute pose of the target, or the override pose if set. False if there is no target
+    bool retVal=false;
     CDummy* targetObject=App::currentInstance->objectContainer->getDummy(getTargetHandle());
-    rowJointHandles=new std::vector<int>;
-    rowJointStages=new std::vector<size_t>;
+    if (targetObject!=nullptr)
+    {
+        if (_targetPoseOverride!=nullptr)
+            tr=_targetPoseOverride[0];
+        else
+            tr=targetObject->getCumulativeTransformationPart1(useTempValues);
+        retVal=true;
+    }
+    return(retVal);
+}
+
+void CikElement::prepareEquations(simReal interpolationFactor)
+{
+    C7Vector targetTr;
+    bool hasTarget=_getTargetTransformation(targetTr,true);
+    // Equation buffers are kept between calls and only reallocated if their shape changes:
+    if (rowJointHandles==nullptr)
+    {
+        rowJointHandles=new std::vector<int>;
+        rowJointStages=new std::vector<size_t>;
+    }
+    rowJointHandles->clear();
+    rowJointStages->clear();
     C4X4Matrix m;
-    CMatrix* jacobian=CIkRoutines::getJacobian(this,m,rowJointHandles,rowJointStages);
+#ifdef IK_FINITE_DIFFERENCE_JACOBIAN
+    bool jacobianOk=CIkRoutines::getJacobian(this,m,_jacobian,_jacobianMatrices,rowJointHandles,rowJointStages);
+#else
+    bool jacobianOk=CIkRoutines::getGeometricJacobian(this,m,_jacobian,rowJointHandles,rowJointStages);
+#endif
+    if (!jacobianOk)
+    {
+        m.setIdentity();
+        CIkRoutines::reserveMatrix(_jacobian,6,0);
+    }
+    CMatrix* jacobian=_jacobian;
     C7Vector oldFrame(m);
-    C7Vector oldFrameInv(oldFrame.getInverse());
+    C7Vector oldFrameInv(CIkKernels::getInverse(oldFrame));
     size_t equationNumber=0;
     size_t doF=jacobian->cols;
     C7Vector currentFrame;
-    if (targetObject!=nullptr)
+    if (hasTarget)
     {
         CSceneObject* baseObject=App::currentInstance->objectContainer->getObject(_baseHandle);
         C7Vector baseTrInv(C7Vector::identityTransformation);
         if (baseObject!=nullptr)
-            baseTrInv=baseObject->getCumulativeTransformation(true).getInverse();
+            baseTrInv=CIkKernels::getInverse(baseObject->getCumulativeTransformation(true));
         CSceneObject* altBaseObject=App::currentInstance->objectContainer->getObject(_altBaseHandleForConstraints);
         if (altBaseObject!=nullptr)
-            baseTrInv=altBaseObject->getCumulativeTransformation(true).getInverse();
-        C7Vector targetTr=targetObject->getCumulativeTransformationPart1(true);
-        targetTr=baseTrInv*targetTr;
+            baseTrInv=CIkKernels::getInverse(altBaseObject->getCumulativeTransformation(true));
+        targetTr=CIkKernels::multiply(baseTrInv,targetTr);
         currentFrame.buildInterpolation(oldFrame,targetTr,interpolationFactor);
         if ((_constraints&sim_ik_x_constraint)!=0)
             equationNumber++;
@@ -241,10 +344,10 @@ void CikElement::prepareEquations(simReal interpolationFactor)
         if ((_constraints&sim_ik_gamma_constraint)!=0)
             equationNumber++;
     }
-    matrix=new CMatrix(equationNumber,doF);
-    matrix_correctJacobian=new CMatrix(equationNumber,doF);
-    errorVector=new CMatrix(equationNumber,1);
-    if (targetObject!=nullptr)
+    CIkRoutines::reserveMatrix(matrix,equationNumber,doF);
+    CIkRoutines::reserveMatrix(matrix_correctJacobian,equationNumber,doF);
+    CIkRoutines::reserveMatrix(errorVector,equationNumber,1);
+    if (hasTarget)
     {
         size_t pos=0;
         if ((_constraints&sim_ik_x_constraint)!=0)
@@ -288,7 +391,7 @@ void CikElement::prepareEquations(simReal interpolationFactor)
                 (*matrix_correctJacobian)(pos+1,i)=(*jacobian)(4,i)*IK_DIVISION_FACTOR;
                 (*matrix_correctJacobian)(pos+2,i)=(*jacobian)(5,i)*IK_DIVISION_FACTOR;
             }
-            C4X4Matrix diff(oldFrameInv*currentFrame);
+            C4X4Matrix diff(CIkKernels::multiply(oldFrameInv,currentFrame));
             C3Vector euler(diff.M.getEulerAngles());
             (*errorVector)(pos,0)=euler(0)*_orientationWeight/IK_DIVISION_FACTOR;
             (*errorVector)(pos+1,0)=euler(1)*_orientationWeight/IK_DIVISION_FACTOR;
@@ -304,14 +407,13 @@ void CikElement::prepareEquations(simReal interpolationFactor)
                 (*matrix_correctJacobian)(pos,i)=(*jacobian)(3,i)*IK_DIVISION_FACTOR;
                 (*matrix_correctJacobian)(pos+1,i)=(*jacobian)(4,i)*IK_DIVISION_FACTOR;
             }
-            C4X4Matrix diff(oldFrameInv*currentFrame);
+            C4X4Matrix diff(CIkKernels::multiply(oldFrameInv,currentFrame));
             C3Vector euler(diff.M.getEulerAngles());
             (*errorVector)(pos,0)=euler(0)*_orientationWeight/IK_DIVISION_FACTOR;
             (*errorVector)(pos+1,0)=euler(1)*_orientationWeight/IK_DIVISION_FACTOR;
             pos=pos+2;
         }
     }
-    delete jacobian;
 }
 
 void CikElement::clearIkEquations()
@@ -326,6 +428,8 @@ void CikElement::clearIkEquations()
     rowJointHandles=nullptr;
     delete rowJointStages;
     rowJointStages=nullptr;
+    delete _jacobian;
+    _jacobian=nullptr;
 }
 
 void CikElement::_getMatrixError(const C4X4Matrix& frame1,const C4X4Matrix& frame2,simReal linAndAngErrors[2]) const
@@ -2,9 +2,12 @@
 
 #include "ik.h"
 #include "serialization.h"
+#include "ikBinaryFormat.h"
 #include <vector>
 #include "4X4Matrix.h"
+#include "4X4FullMatrix.h"
 #include "MMatrix.h"
+#include "ikChainPlan.h"
 
 class CikElement
 {
@@ -15,6 +18,9 @@ public:
     bool announceSceneObjectWillBeErased(int objectHandle);
     void performSceneObjectLoadingMapping(const std::vector<int>* map);
     void serialize(CSerialization& ar);
+    void writeRecord(SIkElementRecord& rec) const;
+    void readRecord(const SIkElementRecord& rec);
+    CikElement* copyYourself() const;
 
     int getIkElementHandle() const;
     int getTipHandle() const;
@@ -27,6 +33,7 @@ public:
     void setRelatedJointsToPassiveMode();
     bool getIsActive() const;
     void setIsActive(bool isActive);
+    const CikChainPlan* getChainPlan();
 
     simReal getMinLinearPrecision() const;
     void setMinLinearPrecision(simReal precision);
@@ -40,6 +47,8 @@ public:
     void setConstraints(int constraints);
 
     void isWithinTolerance(bool& position,bool& orientation,bool useTempValues) const;
+    bool getTipTargetErrors(simReal linAndAngErrors[2],bool useTempValues) const;
+    void setTargetPoseOverride(const C7Vector* pose);
     void prepareEquations(simReal interpolationFactor);
     void clearIkEquations();
 
@@ -51,6 +60,15 @@ public:
 
 private:
     void _getMatrixError(const C4X4Matrix& frame1,const C4X4Matrix& frame2,simReal linAndAngErrors[2]) const;
+    bool _getTargetTransformation(C7Vector& tr,bool useTempValues) const;
+
+    CikChainPlan _chainPlan;
+
+    // Jacobian buffers, reused by each call to prepareEquations:
+    CMatrix* _jacobian;
+    std::vector<C4X4FullMatrix> _jacobianMatrices;
+
+    const C7Vector* _targetPoseOverride; // absolute target pose used instead of the target's one, not owned
 
     int _ikElementHandle;
     int _tipHandle;
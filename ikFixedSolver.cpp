@@ -0,0 +1,117 @@
+#include "simConst.h"
+#include "ikFixedSolver.h"
+
+CIkFixedSolver::SolveFunction CIkFixedSolver::getSolveFunction(size_t rows,size_t doF)
+{
+    switch (rows)
+    {
+        case 1: return(_getSolveFunction<1>(doF));
+        case 2: return(_getSolveFunction<2>(doF));
+        case 3: return(_getSolveFunction<3>(doF));
+        case 4: return(_getSolveFunction<4>(doF));
+        case 5: return(_getSolveFunction<5>(doF));
+        case 6: return(_getSolveFunction<6>(doF));
+    }
+    return(nullptr);
+}
+
+template<size_t ROWS>
+CIkFixedSolver::SolveFunction CIkFixedSolver::_getSolveFunction(size_t doF)
+{
+    switch (doF)
+    {
+        case 1: return(_solve<ROWS,1>);
+        case 2: return(_solve<ROWS,2>);
+        case 3: return(_solve<ROWS,3>);
+        case 4: return(_solve<ROWS,4>);
+        case 5: return(_solve<ROWS,5>);
+        case 6: return(_solve<ROWS,6>);
+        case 7: return(_solve<ROWS,7>);
+        case 8: return(_solve<ROWS,8>);
+    }
+    return(nullptr);
+}
+
+template<size_t ROWS,size_t DOF>
+bool CIkFixedSolver::_solve(const simReal* matrix,const simReal* errorVector,const simReal* weightCoeffs,int calculationMethod,simReal dlsFactor,simReal* solution)
+{ // Loop counts are constants, i.e. the compiler can fully unroll the loops. See also CIkRoutines::solveSymmetricSystem
+    simReal m[ROWS][DOF];
+    for (size_t i=0;i<ROWS;i++)
+    {
+        for (size_t j=0;j<DOF;j++)
+            m[i][j]=matrix[i*DOF+j]*weightCoeffs[j];
+    }
+
+    if ( (calculationMethod==sim_ik_pseudo_inverse_method)||(calculationMethod==sim_ik_damped_least_squares_method) )
+    { // solution=JT*y, with (J*JT+damping)*y=e solved by LDLT factorization
+        simReal jjt[ROWS][ROWS];
+        simReal y[ROWS];
+        for (size_t i=0;i<ROWS;i++)
+        {
+            for (size_t j=0;j<=i;j++)
+            {
+                simReal v=simZero;
+                for (size_t k=0;k<DOF;k++)
+                    v+=m[i][k]*m[j][k];
+                jjt[i][j]=v;
+            }
+            y[i]=errorVector[i];
+        }
+        if (calculationMethod==sim_ik_damped_least_squares_method)
+        {
+            for (size_t i=0;i<ROWS;i++)
+                jjt[i][i]+=dlsFactor*dlsFactor;
+        }
+        for (size_t j=0;j<ROWS;j++)
+        {
+            simReal d=jjt[j][j];
+            for (size_t k=0;k<j;k++)
+                d-=jjt[j][k]*jjt[j][k]*jjt[k][k];
+            if (d<=simZero)
+                return(false);
+            jjt[j][j]=d;
+            for (size_t i=j+1;i<ROWS;i++)
+            {
+                simReal v=jjt[i][j];
+                for (size_t k=0;k<j;k++)
+                    v-=jjt[i][k]*jjt[j][k]*jjt[k][k];
+                jjt[i][j]=v/d;
+            }
+        }
+        for (size_t i=0;i<ROWS;i++)
+        {
+            for (size_t k=0;k<i;k++)
+                y[i]-=jjt[i][k]*y[k];
+        }
+        for (size_t i=0;i<ROWS;i++)
+            y[i]/=jjt[i][i];
+        for (size_t i=ROWS;i>0;i--)
+        {
+            for (size_t k=i;k<ROWS;k++)
+                y[i-1]-=jjt[k][i-1]*y[k];
+        }
+        for (size_t k=0;k<DOF;k++)
+        {
+            simReal v=simZero;
+            for (size_t i=0;i<ROWS;i++)
+                v+=m[i][k]*y[i];
+            solution[k]=v*fabs(weightCoeffs[k]);
+        }
+    }
+    else if (calculationMethod==sim_ik_jacobian_transpose_method)
+    {
+        for (size_t k=0;k<DOF;k++)
+        {
+            simReal v=simZero;
+            for (size_t i=0;i<ROWS;i++)
+                v+=m[i][k]*errorVector[i];
+            solution[k]=v*fabs(weightCoeffs[k]);
+        }
+    }
+    else
+    {
+        for (size_t k=0;k<DOF;k++)
+            solution[k]=simZero;
+    }
+    return(true);
+}
@@ -0,0 +1,21 @@
+#pragma once
+
+#include "ik.h"
+
+class CIkFixedSolver
+{ // Solver kernels for the small systems of CikGroup::performOnePass (up to 6 rows and 8 columns), with the system size
+  // known at compile time and all storage on the stack. They do the same operations in the same order as the generic
+  // path, i.e. give the same results
+public:
+    // Scales the columns of matrix (row-major, rows x doF) by weightCoeffs, solves with calculationMethod, and scales
+    // the solution (doF) by the absolute weightCoeffs. Returns false if the system could not be solved:
+    typedef bool (*SolveFunction)(const simReal* matrix,const simReal* errorVector,const simReal* weightCoeffs,int calculationMethod,simReal dlsFactor,simReal* solution);
+
+    static SolveFunction getSolveFunction(size_t rows,size_t doF); // nullptr if there is no kernel for that size
+
+private:
+    template<size_t ROWS>
+    static SolveFunction _getSolveFunction(size_t doF);
+    template<size_t ROWS,size_t DOF>
+    static bool _solve(const simReal* matrix,const simReal* errorVector,const simReal* weightCoeffs,int calculationMethod,simReal dlsFactor,simReal* solution);
+};
@@ -1,8 +1,10 @@
 #include "simConst.h"
 #include "ikGroup.h"
 #include "ikRoutines.h"
+#include "ikFixedSolver.h"
 #include "app.h"
 #include <algorithm>
+#include <map>
 
 
 CikGroup::CikGroup()
@@ -35,6 +37,35 @@ CikGroup::~CikGroup()
     delete _lastJacobian;
 }
 
+CikGroup* CikGroup::copyYourself() const
+{ // The workspace is not copied
+    CikGroup* newGroup=new CikGroup();
+    for (size_t i=0;i<ikElements.size();i++)
+        newGroup->ikElements.push_back(ikElements[i]->copyYourself());
+    newGroup->objectID=objectID;
+    newGroup->objectName=objectName;
+    newGroup->maxIterations=maxIterations;
+    newGroup->active=active;
+    newGroup->_correctJointLimits=_correctJointLimits;
+    newGroup->dlsFactor=dlsFactor;
+    newGroup->calculationMethod=calculationMethod;
+    newGroup->restoreIfPositionNotReached=restoreIfPositionNotReached;
+    newGroup->restoreIfOrientationNotReached=restoreIfOrientationNotReached;
+    newGroup->doOnFailOrSuccessOf=doOnFailOrSuccessOf;
+    newGroup->doOnFail=doOnFail;
+    newGroup->doOnPerformed=doOnPerformed;
+    newGroup->constraints=constraints;
+    newGroup->jointLimitWeight=jointLimitWeight;
+    newGroup->jointTreshholdAngular=jointTreshholdAngular;
+    newGroup->jointTreshholdLinear=jointTreshholdLinear;
+    newGroup->ignoreMaxStepSizes=ignoreMaxStepSizes;
+    newGroup->_calculationResult=_calculationResult;
+    if (_lastJacobian!=nullptr)
+        newGroup->_lastJacobian=new CMatrix(*_lastJacobian);
+    newGroup->_explicitHandling=_explicitHandling;
+    return(newGroup);
+}
+
 void CikGroup::performObjectLoadingMapping(std::vector<int>* map)
 {
     for (size_t i=0;i<ikElements.size();i++)
@@ -192,6 +223,7 @@ void CikGroup::removeIkElement(int elementID)
         {
             delete ikElements[i];
             ikElements.erase(ikElements.begin()+i);
+            _workspace.columnMapVersion=0; // element addresses could be reused
             break;
         }
     }
@@ -270,50 +302,30 @@ void CikGroup::getAllActiveJoints(std::vector<CJoint*>& jointList) const
     for (size_t elNb=0;elNb<ikElements.size();elNb++)
     {
         CikElement* element=ikElements[elNb];
-        CDummy* tooltip=App::currentInstance->objectContainer->getDummy(element->getTipHandle());
-        CSceneObject* base=App::currentInstance->objectContainer->getObject(element->getBaseHandle());
+        const CikChainPlan* plan=element->getChainPlan();
         bool valid=true;
         if (!element->getIsActive())
             valid=false;
-        if (tooltip==nullptr)
+        if (plan->tip==nullptr)
             valid=false;
         // We check that tooltip is parented with base and has at least one joint in-between:
         if (valid)
         {
-            valid=false;
-            bool jointPresent=false;
-            bool baseOk=false;
-            CSceneObject* iterat=tooltip;
-            while ( (iterat!=base)&&(iterat!=nullptr) )
-            {
-                iterat=iterat->getParentObject();
-                if (iterat==base)
-                {
-                    baseOk=true;
-                    if (jointPresent)
-                        valid=true;
-                }
-                if ( (iterat!=base)&&(iterat!=nullptr)&&(iterat->getObjectType()==sim_object_joint_type) )
-                    jointPresent=true;
-            }
+            valid=( plan->baseOk&&(plan->chainJoints.size()!=0) );
             if (!valid)
             {
                 element->setIsActive(false); // This element has an error
-                if (!baseOk)
+                if (!plan->baseOk)
                     element->setBaseHandle(-1); // The base was illegal!
             }
         }
         if (valid)
         { // We add all joint between tooltip and base which are not yet present:
-            CSceneObject* iterat=tooltip;
-            while ( (iterat!=base)&&(iterat!=nullptr) )
+            for (size_t i=0;i<plan->chainJoints.size();i++)
             {
-                if (iterat->getObjectType()==sim_object_joint_type)
-                {
-                    if (std::find(jointList.begin(),jointList.end(),iterat)==jointList.end())
-                        jointList.push_back(static_cast<CJoint*>(iterat));
-                }
-                iterat=iterat->getParentObject();
+                CJoint* joint=plan->chainJoints[i];
+                if (std::find(jointList.begin(),jointList.end(),joint)==jointList.end())
+                    jointList.push_back(joint);
             }
         }
     }
@@ -324,9 +336,9 @@ void CikGroup::getTipAndTargetLists(std::vector<CDummy*>& tipList,std::vector<CD
     for (size_t elNb=0;elNb<ikElements.size();elNb++)
     {
         CikElement* element=ikElements[elNb];
-        CDummy* tooltip=App::currentInstance->objectContainer->getDummy(element->getTipHandle());
+        const CikChainPlan* plan=element->getChainPlan();
+        CDummy* tooltip=plan->tip;
         CDummy* target=App::currentInstance->objectContainer->getDummy(element->getTargetHandle());
-        CSceneObject* base=App::currentInstance->objectContainer->getObject(element->getBaseHandle());
         bool valid=true;
         if (!element->getIsActive())
             valid=false;
@@ -337,26 +349,11 @@ void CikGroup::getTipAndTargetLists(std::vector<CDummy*>& tipList,std::vector<CD
         // We check that tooltip is parented with base and has at least one joint in-between:
         if (valid)
         {
-            valid=false;
-            bool jointPresent=false;
-            bool baseOk=false;
-            CSceneObject* iterat=tooltip;
-            while ( (iterat!=base)&&(iterat!=nullptr) )
-            {
-                iterat=iterat->getParentObject();
-                if (iterat==base)
-                {
-                    baseOk=true;
-                    if (jointPresent)
-                        valid=true;
-                }
-                if ( (iterat!=base)&&(iterat!=nullptr)&&(iterat->getObjectType()==sim_object_joint_type) )
-                    jointPresent=true;
-            }
+            valid=( plan->baseOk&&(plan->chainJoints.size()!=0) );
             if (!valid)
             {
                 element->setIsActive(false); // This element has an error
-                if (!baseOk)
+                if (!plan->baseOk)
                     element->setBaseHandle(-1); // The base was illegal!
             }
         }
@@ -370,6 +367,64 @@ void CikGroup::getTipAndTargetLists(std::vector<CDummy*>& tipList,std::vector<CD
 
 int CikGroup::computeGroupIk(bool forInternalFunctionality)
 { // Return value is one of following: sim_ikresult_not_performed, sim_ikresult_success, sim_ikresult_fail
+    bool setNewValues;
+    int iterationCnt;
+    int retVal=_computeGroupIk(forInternalFunctionality,nullptr,nullptr,setNewValues,iterationCnt);
+    // We set all joint parameters:
+    if (setNewValues)
+        _applyTemporaryParameters();
+    return(retVal);
+}
+
+int CikGroup::solveGroupIk(const std::vector<CJoint*>& joints,const simReal* initialJointValues,const C7Vector* targetPoses,simReal* jointValues,simReal* residuals,int* iterationCnt)
+{ // Like computeGroupIk, but starts from initialJointValues instead of the joint positions, and with optional absolute
+    // target poses (one per IK element). The solution is returned in jointValues, and the joint positions are not modified.
+    // residuals receives the linear and angular error of each IK element for that solution. Conditional execution is ignored.
+    // The temporary joint parameters, the elements' target pose overrides and the workspace are used as scratch space, i.e.
+    // the call is not reentrant
+    if (targetPoses!=nullptr)
+    {
+        for (size_t i=0;i<ikElements.size();i++)
+            ikElements[i]->setTargetPoseOverride(targetPoses+i);
+    }
+    bool newValuesValid;
+    int iterations;
+    int retVal=_computeGroupIk(true,&joints,initialJointValues,newValuesValid,iterations);
+    if (newValuesValid)
+    { // same clamping/wrapping as when applied:
+        for (size_t i=0;i<joints.size();i++)
+            joints[i]->setPosition(joints[i]->getPosition(true),true);
+    }
+    else
+        _resetTemporaryParameters(&joints,initialJointValues);
+    for (size_t i=0;i<joints.size();i++)
+        jointValues[i]=joints[i]->getPosition(true);
+    if (residuals!=nullptr)
+    {
+        for (size_t i=0;i<ikElements.size();i++)
+        {
+            if (!ikElements[i]->getTipTargetErrors(residuals+2*i,true))
+            {
+                residuals[2*i+0]=simZero;
+                residuals[2*i+1]=simZero;
+            }
+        }
+    }
+    if (iterationCnt!=nullptr)
+        iterationCnt[0]=iterations;
+    if (targetPoses!=nullptr)
+    {
+        for (size_t i=0;i<ikElements.size();i++)
+            ikElements[i]->setTargetPoseOverride(nullptr);
+    }
+    return(retVal);
+}
+
+int CikGroup::_computeGroupIk(bool forInternalFunctionality,const std::vector<CJoint*>* initialJoints,const simReal* initialJointValues,bool& setNewValues,int& iterationCnt)
+{ // Works on the temporary joint parameters only. setNewValues indicates whether they should be applied
+    setNewValues=false;
+    iterationCnt=0;
+    _prepareJointFootprint();
     if (!active)
         return(sim_ikresult_not_performed); // That group is not active!
     if (!forInternalFunctionality)
@@ -404,46 +459,26 @@ int CikGroup::computeGroupIk(bool forInternalFunctionality)
     }
 
     // Now we prepare a vector with all valid and active elements:
-    std::vector<CikElement*> validElements;
-    validElements.reserve(ikElements.size());
+    std::vector<CikElement*>& validElements=_workspace.validElements;
     validElements.clear();
 
     for (size_t elNb=0;elNb<ikElements.size();elNb++)
     {
         CikElement* element=ikElements[elNb];
-        CDummy* tooltip=App::currentInstance->objectContainer->getDummy(element->getTipHandle());
-        CSceneObject* base=App::currentInstance->objectContainer->getObject(element->getBaseHandle());
+        const CikChainPlan* plan=element->getChainPlan();
         bool valid=true;
         if (!element->getIsActive())
             valid=false;
-        if (tooltip==nullptr)
+        if (plan->tip==nullptr)
             valid=false; // should normally never happen!
-        // We check that tooltip is parented with base and has at least one joint in-between:
+        // We check that tooltip is parented with base and has at least one IK joint in-between:
         if (valid)
         {
-            valid=false;
-            bool jointPresent=false;
-            bool baseOk=false;
-            CSceneObject* iterat=tooltip;
-            while ( (iterat!=base)&&(iterat!=nullptr) )
-            {
-                iterat=iterat->getParentObject();
-                if (iterat==base)
-                {
-                    baseOk=true;
-                    if (jointPresent)
-                        valid=true;
-                }
-                if ( (iterat!=base)&&(iterat!=nullptr)&&(iterat->getObjectType()==sim_object_joint_type) )
-                { 
-                    if ( ((static_cast<CJoint*>(iterat))->getJointMode()==sim_jointmode_ik)||((static_cast<CJoint*>(iterat))->getJointMode()==sim_jointmode_reserved_previously_ikdependent)||((static_cast<CJoint*>(iterat))->getJointMode()==sim_jointmode_dependent) )
-                        jointPresent=true;
-                }
-            }
+            valid=( plan->baseOk&&(plan->doF!=0) );
             if (!valid)
             {
                 element->setIsActive(false); // This element has an error
-                if (!baseOk)
+                if (!plan->baseOk)
                     element->setBaseHandle(-1); // The base was illegal!
             }
         }
@@ -456,7 +491,7 @@ int CikGroup::computeGroupIk(bool forInternalFunctionality)
         return(sim_ikresult_fail); // Error!
     }
 
-    _resetTemporaryParameters();
+    _resetTemporaryParameters(initialJoints,initialJointValues);
 
     // Here we have the main iteration loop:
     simReal interpolFact=1.0; // We first try to solve in one step
@@ -466,6 +501,7 @@ int CikGroup::computeGroupIk(bool forInternalFunctionality)
     bool errorOccured=false;
     for (int iterationNb=0;iterationNb<maxIterations;iterationNb++)
     {
+        iterationCnt++;
         // Here we prepare all element equations:
         for (size_t elNb=0;elNb<validElements.size();elNb++)
         {
@@ -504,22 +540,17 @@ int CikGroup::computeGroupIk(bool forInternalFunctionality)
         { // Joint variations not within tolerance
             successNumber=0;
             interpolFact=interpolFact/simReal(2.0);
-            _resetTemporaryParameters();
+            _resetTemporaryParameters(initialJoints,initialJointValues);
         }
 
-        // Here we remove all element equations (free memory)
-        for (size_t elNb=0;elNb<validElements.size();elNb++)
-        {
-            CikElement* element=validElements[elNb];
-            element->clearIkEquations();
-        }
+        // Element equation buffers are kept for the next pass (and next call)
         if (leaveNow)
             break;
     }
     int returnValue=sim_ikresult_success;
     if (errorOccured)
         returnValue=sim_ikresult_fail;
-    bool setNewValues=(!errorOccured);
+    setNewValues=(!errorOccured);
     for (size_t elNb=0;elNb<validElements.size();elNb++)
     {
         CikElement* element=validElements[elNb];
@@ -533,79 +564,199 @@ int CikGroup::computeGroupIk(bool forInternalFunctionality)
                 setNewValues=false;
         }
     }
-
-    // We set all joint parameters:
-    if (setNewValues)
-        _applyTemporaryParameters();
     return(returnValue);
 }
 
-void CikGroup::_resetTemporaryParameters()
+void CikGroup::_resetTemporaryParameters(const std::vector<CJoint*>* initialJoints,const simReal* initialJointValues)
 {
-    // We prepare all joint temporary parameters:
-    for (size_t jc=0;jc<App::currentInstance->objectContainer->jointList.size();jc++)
+    // We prepare the temporary parameters of the joints the computation depends on:
+    for (size_t jc=0;jc<_workspace.readJoints.size();jc++)
     {
-        CJoint* it=App::currentInstance->objectContainer->getJoint(App::currentInstance->objectContainer->jointList[jc]);
+        CJoint* it=_workspace.readJoints[jc];
         it->setPosition(it->getPosition(),true);
         it->initializeParametersForIK(getJointTreshholdAngular());
     }
+    // Then the start values that replace the joint positions, if any:
+    if (initialJoints!=nullptr)
+    {
+        for (size_t i=0;i<initialJoints->size();i++)
+            initialJoints->at(i)->setPosition(initialJointValues[i],true);
+    }
 }
 
 void CikGroup::_applyTemporaryParameters()
 {
     // Joints:
-    for (size_t jc=0;jc<App::currentInstance->objectContainer->jointList.size();jc++)
+    for (size_t jc=0;jc<_workspace.readJoints.size();jc++)
     {
-        CJoint* it=App::currentInstance->objectContainer->getJoint(App::currentInstance->objectContainer->jointList[jc]);
+        CJoint* it=_workspace.readJoints[jc];
         it->setPosition(it->getPosition(true),false);
         it->applyTempParametersEx();
     }
 }
 
-int CikGroup::performOnePass(std::vector<CikElement*>* validElements,bool& limitOrAvoidanceNeedMoreCalculation,simReal interpolFact,bool forInternalFunctionality)
-{   // Return value -1 means that an error occured --> keep old configuration
-    // Return value 0 means that the max. angular or linear variation were overpassed.
-    // Return value 1 means everything went ok
-    // In that case the joints temp. values are not actualized. Another pass is needed
-    // Here we have the multi-ik solving algorithm:
-    //********************************************************************************
-    limitOrAvoidanceNeedMoreCalculation=false;
-    // We prepare a vector of all used joints and a counter for the number of rows:
-    std::vector<CJoint*> allJoints;
-    std::vector<size_t> allJointStages;
-    size_t numberOfRows=0;
-    for (size_t elNb=0;elNb<validElements->size();elNb++)
+const std::vector<CJoint*>& CikGroup::getReadJoints()
+{ // The joints the computation depends on, i.e. the joints above the tips, targets and bases, and the masters of the
+    // dependent ones. Only those are reset and applied: joints elsewhere in the scene are not touched
+    _prepareJointFootprint();
+    return(_workspace.readJoints);
+}
+
+const std::vector<CJoint*>& CikGroup::getTouchedJoints()
+{ // The read joints, and the joints that depend on them, since those move too when the group's results are applied
+    _prepareJointFootprint();
+    return(_workspace.touchedJoints);
+}
+
+void CikGroup::_prepareJointFootprint()
+{ // Only rebuilt if the topology, a joint dependency or an element's tip/target/base changed. The cost of a computation
+    // therefore does not depend on the number of joints in the scene
+    unsigned int topologyVersion=App::currentInstance->objectContainer->getTopologyVersion();
+    std::vector<int>& handles=_workspace.footprintHandles;
+    bool upToDate=( (_workspace.footprintVersion==topologyVersion)&&(handles.size()==4*ikElements.size()) );
+    for (size_t elNb=0;upToDate&&(elNb<ikElements.size());elNb++)
     {
-        CikElement* element=validElements->at(elNb);
-        numberOfRows+=element->matrix->rows;
+        CikElement* element=ikElements[elNb];
+        upToDate=( (handles[4*elNb+0]==element->getTipHandle())&&(handles[4*elNb+1]==element->getTargetHandle())&&(handles[4*elNb+2]==element->getBaseHandle())&&(handles[4*elNb+3]==element->getAltBaseHandleForConstraints()) );
+    }
+    if (upToDate)
+        return;
+
+    _workspace.footprintVersion=topologyVersion;
+    handles.clear();
+    std::vector<CJoint*>& readJoints=_workspace.readJoints;
+    readJoints.clear();
+    for (size_t elNb=0;elNb<ikElements.size();elNb++)
+    {
+        CikElement* element=ikElements[elNb];
+        handles.push_back(element->getTipHandle());
+        handles.push_back(element->getTargetHandle());
+        handles.push_back(element->getBaseHandle());
+        handles.push_back(element->getAltBaseHandleForConstraints());
+        for (size_t i=handles.size()-4;i<handles.size();i++)
+        {
+            CSceneObject* it=App::currentInstance->objectContainer->getObject(handles[i]);
+            while (it!=nullptr)
+            {
+                if (it->getObjectType()==sim_object_joint_type)
+                {
+                    CJoint* joint=static_cast<CJoint*>(it);
+                    while ( (joint!=nullptr)&&(std::find(readJoints.begin(),readJoints.end(),joint)==readJoints.end()) )
+                    {
+                        readJoints.push_back(joint);
+                        joint=App::currentInstance->objectContainer->getDependencyMaster(joint);
+                    }
+                }
+                it=it->getParentObject();
+            }
+        }
+    }
+
+    // Dependency closure. Dependents of dependents are rectified too:
+    std::vector<CJoint*>& touchedJoints=_workspace.touchedJoints;
+    touchedJoints=readJoints;
+    for (size_t i=0;i<touchedJoints.size();i++)
+    {
+        for (size_t j=0;j<touchedJoints[i]->dependentJoints.size();j++)
+        {
+            CJoint* dependent=touchedJoints[i]->dependentJoints[j];
+            if (std::find(touchedJoints.begin(),touchedJoints.end(),dependent)==touchedJoints.end())
+                touchedJoints.push_back(dependent);
+        }
+    }
+}
+
+void CikGroup::_prepareColumnMap(const std::vector<CikElement*>& validElements)
+{   // Maps each (joint,stage) column of the valid elements to a column of the main matrix.
+    // Only rebuilt if the topology, a joint mode or the set of valid elements changed
+    unsigned int topologyVersion=App::currentInstance->objectContainer->getTopologyVersion();
+    bool upToDate=( (_workspace.columnMapVersion==topologyVersion)&&(_workspace.columnMapElements.size()==validElements.size()) );
+    for (size_t elNb=0;upToDate&&(elNb<validElements.size());elNb++)
+    {
+        CikElement* element=validElements[elNb];
+        upToDate=( (_workspace.columnMapElements[elNb]==element)&&(_workspace.columnMapPlanBuilds[elNb]==element->getChainPlan()->buildCount) );
+    }
+    if (upToDate)
+        return;
+
+    std::vector<CJoint*>& allJoints=_workspace.allJoints;
+    std::vector<size_t>& allJointStages=_workspace.allJointStages;
+    allJoints.clear();
+    allJointStages.clear();
+    _workspace.elementColumnOffsets.clear();
+    _workspace.elementColumns.clear();
+    _workspace.dependentColumns.clear();
+    _workspace.dependentMasterColumns.clear();
+    _workspace.columnMapElements.clear();
+    _workspace.columnMapPlanBuilds.clear();
+    std::map<std::pair<int,size_t>,size_t> columnOfJointStage;
+    for (size_t elNb=0;elNb<validElements.size();elNb++)
+    {
+        CikElement* element=validElements[elNb];
+        _workspace.elementColumnOffsets.push_back(_workspace.elementColumns.size());
         for (size_t i=0;i<element->rowJointHandles->size();i++)
         {
-            int current=element->rowJointHandles->at(i);
-            size_t currentStage=element->rowJointStages->at(i);
-            // We check if that joint is already present:
-            bool present=false;
+            std::pair<int,size_t> key(element->rowJointHandles->at(i),element->rowJointStages->at(i));
+            std::map<std::pair<int,size_t>,size_t>::iterator it=columnOfJointStage.find(key);
+            if (it==columnOfJointStage.end())
+            { // That joint is not yet present:
+                it=columnOfJointStage.insert(std::make_pair(key,allJoints.size())).first;
+                allJoints.push_back(App::currentInstance->objectContainer->getJoint(key.first));
+                allJointStages.push_back(key.second);
+            }
+            _workspace.elementColumns.push_back(it->second);
+        }
+        _workspace.columnMapElements.push_back(element);
+        _workspace.columnMapPlanBuilds.push_back(element->getChainPlan()->buildCount);
+    }
+
+    // Joints in dependent mode get an additional equation:
+    for (size_t i=0;i<allJoints.size();i++)
+    {
+        if ( ((allJoints[i]->getJointMode()==sim_jointmode_dependent)||(allJoints[i]->getJointMode()==sim_jointmode_reserved_previously_ikdependent))&&(allJoints[i]->getJointType()!=sim_joint_spherical_subtype) )
+        {
+            int masterColumn=-1;
+            int dependenceID=allJoints[i]->getDependencyJointHandle();
             for (size_t j=0;j<allJoints.size();j++)
             {
-                if ( (allJoints[j]->getObjectHandle()==current)&&(allJointStages[j]==currentStage) )
+                if ( (dependenceID!=-1)&&(allJoints[j]->getObjectHandle()==dependenceID) )
                 {
-                    present=true;
+                    masterColumn=int(j);
                     break;
                 }
             }
-            if (!present)
-            {
-                allJoints.push_back(App::currentInstance->objectContainer->getJoint(current));
-                allJointStages.push_back(currentStage);
-            }
+            _workspace.dependentColumns.push_back(i);
+            _workspace.dependentMasterColumns.push_back(masterColumn);
         }
     }
+    _workspace.columnMapVersion=topologyVersion;
+}
+
+int CikGroup::performOnePass(std::vector<CikElement*>* validElements,bool& limitOrAvoidanceNeedMoreCalculation,simReal interpolFact,bool forInternalFunctionality)
+{   // Return value -1 means that an error occured --> keep old configuration
+    // Return value 0 means that the max. angular or linear variation were overpassed.
+    // Return value 1 means everything went ok
+    // In that case the joints temp. values are not actualized. Another pass is needed
+    // Here we have the multi-ik solving algorithm:
+    //********************************************************************************
+    limitOrAvoidanceNeedMoreCalculation=false;
+    // We prepare a vector of all used joints and a counter for the number of rows:
+    _prepareColumnMap(*validElements);
+    std::vector<CJoint*>& allJoints=_workspace.allJoints;
+    std::vector<size_t>& allJointStages=_workspace.allJointStages;
+    size_t numberOfRows=0;
+    for (size_t elNb=0;elNb<validElements->size();elNb++)
+        numberOfRows+=validElements->at(elNb)->matrix->rows;
     //---------------------------------------------------------------------------
 
     // Now we prepare the joint limitation part:
     //---------------------------------------------------------------------------
-    std::vector<simReal> limitationError;
-    std::vector<size_t> limitationIndex;
-    std::vector<simReal> limitationValue;
+    std::vector<simReal>& limitationError=_workspace.limitationError;
+    std::vector<size_t>& limitationIndex=_workspace.limitationIndex;
+    std::vector<simReal>& limitationValue=_workspace.limitationValue;
+    limitationError.clear();
+    limitationIndex.clear();
+    limitationValue.clear();
     if (_correctJointLimits)
     {
         for (size_t jointCounter=0;jointCounter<allJoints.size();jointCounter++)
@@ -710,44 +861,32 @@ int CikGroup::performOnePass(std::vector<CikElement*>* validElements,bool& limit
 
     // Now we prepare the individual joint constraints part:
     //---------------------------------------------------------------------------
-    for (size_t i=0;i<allJoints.size();i++)
-    {
-        if (allJoints[i]->getJointType()!=sim_joint_spherical_subtype)
-        {
-            if ( (allJoints[i]->getJointMode()==sim_jointmode_reserved_previously_ikdependent)||(allJoints[i]->getJointMode()==sim_jointmode_dependent) )
-                numberOfRows++;
-        }
-    }
+    numberOfRows+=_workspace.dependentColumns.size();
     //---------------------------------------------------------------------------
 
-    // We prepare the main matrix and the main error vector.
-    CMatrix mainMatrix(numberOfRows,allJoints.size());
-    CMatrix mainMatrix_correctJacobian(numberOfRows,allJoints.size());
-    // We have to zero it first:
-    mainMatrix.clear();
-    mainMatrix_correctJacobian.clear();
-    CMatrix mainErrorVector(numberOfRows,1);
+    // We prepare the main matrix and the main error vector (zeroed):
+    _workspace.prepareMainSystem(numberOfRows,allJoints.size());
+    size_t doF=_workspace.doF;
+    simReal* mainMatrix=_workspace.mainMatrix.data();
+    simReal* mainMatrix_correctJacobian=_workspace.mainMatrix_correctJacobian.data();
+    simReal* mainErrorVector=_workspace.mainErrorVector.data();
     
     // Now we fill in the main matrix and the main error vector:
     size_t currentRow=0;
     for (size_t elNb=0;elNb<validElements->size();elNb++)
     {
         CikElement* element=validElements->at(elNb);
+        const size_t* columns=_workspace.elementColumns.data()+_workspace.elementColumnOffsets[elNb];
         for (size_t i=0;i<element->errorVector->rows;i++)
         { // We go through the rows:
             // We first set the error part:
-            mainErrorVector(currentRow,0)=(*element->errorVector)(i,0);
+            mainErrorVector[currentRow]=(*element->errorVector)(i,0);
             // Now we set the delta-parts:
             for (size_t j=0;j<element->matrix->cols;j++)
             { // We go through the columns:
-                // We search for the right entry
-                int jointID=element->rowJointHandles->at(j);
-                size_t stage=element->rowJointStages->at(j);
-                size_t index=0;
-                while ( (allJoints[index]->getObjectHandle()!=jointID)||(allJointStages[index]!=stage) )
-                    index++;
-                mainMatrix(currentRow,index)=(*element->matrix)(i,j);
-                mainMatrix_correctJacobian(currentRow,index)=(*element->matrix_correctJacobian)(i,j);
+                size_t index=columns[j];
+                mainMatrix[currentRow*doF+index]=(*element->matrix)(i,j);
+                mainMatrix_correctJacobian[currentRow*doF+index]=(*element->matrix_correctJacobian)(i,j);
             }
             currentRow++;
         }
@@ -755,134 +894,150 @@ int CikGroup::performOnePass(std::vector<CikElement*>* validElements,bool& limit
     // Now we add the joint limitation equations:
     for (size_t i=0;i<limitationError.size();i++)
     { // We go through the rows:
-        mainErrorVector(currentRow,0)=limitationError[i];
+        mainErrorVector[currentRow]=limitationError[i];
         // Now we set the delta-part:
-        mainMatrix(currentRow,limitationIndex[i])=limitationValue[i];
-        mainMatrix_correctJacobian(currentRow,limitationIndex[i])=limitationValue[i];
+        mainMatrix[currentRow*doF+limitationIndex[i]]=limitationValue[i];
+        mainMatrix_correctJacobian[currentRow*doF+limitationIndex[i]]=limitationValue[i];
         currentRow++;
     }
 
     // Now we prepare the individual joint constraints part:
     //---------------------------------------------------------------------------
-    for (size_t i=0;i<allJoints.size();i++)
+    for (size_t k=0;k<_workspace.dependentColumns.size();k++)
     {
-        if ( ((allJoints[i]->getJointMode()==sim_jointmode_dependent)||(allJoints[i]->getJointMode()==sim_jointmode_reserved_previously_ikdependent))&&(allJoints[i]->getJointType()!=sim_joint_spherical_subtype) )
+        size_t i=_workspace.dependentColumns[k];
+        int dependenceID=allJoints[i]->getDependencyJointHandle();
+        if (dependenceID!=-1)
         {
-            int dependenceID=allJoints[i]->getDependencyJointHandle();
-            if (dependenceID!=-1)
+            int depJointColumn=_workspace.dependentMasterColumns[k];
+            if (depJointColumn!=-1)
             {
-                bool found=false;
-                size_t depJointIndex;
-                for (depJointIndex=0;depJointIndex<allJoints.size();depJointIndex++)
-                {
-                    if (allJoints[depJointIndex]->getObjectHandle()==dependenceID)
-                    {
-                        found=true;
-                        break;
-                    }
-                }
-                if (found)
+                size_t depJointIndex=size_t(depJointColumn);
+                simReal coeff=allJoints[i]->getDependencyJointMult();
+                simReal fact=allJoints[i]->getDependencyJointAdd();
+                mainErrorVector[currentRow]=((allJoints[i]->getPosition(true)-fact)-
+                                coeff*allJoints[depJointIndex]->getPosition(true))*interpolFact;
+                mainMatrix[currentRow*doF+i]=-simOne;
+                mainMatrix[currentRow*doF+depJointIndex]=coeff;
+                mainMatrix_correctJacobian[currentRow*doF+i]=-simOne;
+                mainMatrix_correctJacobian[currentRow*doF+depJointIndex]=coeff;
+            }
+            else
+            {   // joint of dependenceID is not part of this group calculation:
+                // therefore we take its current value --> WRONG! Since all temp params are initialized!
+                CJoint* dependentJoint=App::currentInstance->objectContainer->getJoint(dependenceID);
+                if (dependentJoint!=nullptr)
                 {
                     simReal coeff=allJoints[i]->getDependencyJointMult();
                     simReal fact=allJoints[i]->getDependencyJointAdd();
-                    mainErrorVector(currentRow,0)=((allJoints[i]->getPosition(true)-fact)-
-                                    coeff*allJoints[depJointIndex]->getPosition(true))*interpolFact;
-                    mainMatrix(currentRow,i)=-simOne;
-                    mainMatrix(currentRow,depJointIndex)=coeff;
-                    mainMatrix_correctJacobian(currentRow,i)=-simOne;
-                    mainMatrix_correctJacobian(currentRow,depJointIndex)=coeff;
-                }
-                else
-                {   // joint of dependenceID is not part of this group calculation:
-                    // therefore we take its current value --> WRONG! Since all temp params are initialized!
-                    CJoint* dependentJoint=App::currentInstance->objectContainer->getJoint(dependenceID);
-                    if (dependentJoint!=nullptr)
-                    {
-                        simReal coeff=allJoints[i]->getDependencyJointMult();
-                        simReal fact=allJoints[i]->getDependencyJointAdd();
-                        mainErrorVector(currentRow,0)=((allJoints[i]->getPosition(true)-fact)-
-                                        coeff*dependentJoint->getPosition(true))*interpolFact;
-                        mainMatrix(currentRow,i)=-simOne;
-                        mainMatrix_correctJacobian(currentRow,i)=-simOne;
-                    }
+                    mainErrorVector[currentRow]=((allJoints[i]->getPosition(true)-fact)-
+                                    coeff*dependentJoint->getPosition(true))*interpolFact;
+                    mainMatrix[currentRow*doF+i]=-simOne;
+                    mainMatrix_correctJacobian[currentRow*doF+i]=-simOne;
                 }
             }
-            else
-            {               
-                mainErrorVector(currentRow,0)=interpolFact*(allJoints[i]->getPosition(true)-allJoints[i]->getDependencyJointAdd());
-                mainMatrix(currentRow,i)=-simOne;
-                mainMatrix_correctJacobian(currentRow,i)=-simOne;
-            }
-            currentRow++;
         }
+        else
+        {               
+            mainErrorVector[currentRow]=interpolFact*(allJoints[i]->getPosition(true)-allJoints[i]->getDependencyJointAdd());
+            mainMatrix[currentRow*doF+i]=-simOne;
+            mainMatrix_correctJacobian[currentRow*doF+i]=-simOne;
+        }
+        currentRow++;
     }
     //---------------------------------------------------------------------------
 
-    // We take the joint weights into account here (part1):
-    for (size_t i=0;i<mainMatrix.rows;i++)
+    // Common system sizes (e.g. one 6-row element over 6 or 7 joints) are solved by a kernel specialized for that size:
+    CIkFixedSolver::SolveFunction fixedSolve=CIkFixedSolver::getSolveFunction(numberOfRows,doF);
+
+    // We take the joint weights into account here (part1). The fixed-size kernels scale the main matrix themselves:
+    simReal* weightCoeffs=_workspace.weightCoeffs.data();
+    for (size_t j=0;j<doF;j++)
     {
-        for (size_t j=0;j<allJoints.size();j++)
+        simReal coeff=allJoints[j]->getIkWeight();
+        if (coeff>=simZero)
+            coeff=sqrt(coeff);
+        else
+            coeff=-sqrt(-coeff);
+        weightCoeffs[j]=coeff;
+        if (fixedSolve==nullptr)
         {
-            simReal coeff=allJoints[j]->getIkWeight();
-            if (coeff>=simZero)
-                coeff=sqrt(coeff);
-            else
-                coeff=-sqrt(-coeff);
-            mainMatrix(i,j)=mainMatrix(i,j)*coeff;
-            mainMatrix_correctJacobian(i,j)=mainMatrix_correctJacobian(i,j)*coeff;
+            for (size_t i=0;i<numberOfRows;i++)
+                mainMatrix[i*doF+j]*=coeff;
+        }
+        if (!forInternalFunctionality)
+        { // only used for the last Jacobian
+            for (size_t i=0;i<numberOfRows;i++)
+                mainMatrix_correctJacobian[i*doF+j]*=coeff;
         }
     }
 
     // Now we just have to solve:
-    size_t doF=mainMatrix.cols;
-    size_t eqNumb=mainMatrix.rows;
-    CMatrix solution(doF,1);
+    size_t eqNumb=numberOfRows;
+    simReal* solution=_workspace.solution.data();
 
     if (!forInternalFunctionality)
     {
-        delete _lastJacobian;
-        _lastJacobian=new CMatrix(mainMatrix_correctJacobian);
+        CIkRoutines::reserveMatrix(_lastJacobian,eqNumb,doF);
+        for (size_t i=0;i<eqNumb*doF;i++)
+            _lastJacobian->data[i]=mainMatrix_correctJacobian[i];
     }
 
-    if (calculationMethod==sim_ik_pseudo_inverse_method)
-    {
-        CMatrix JT(mainMatrix);
-        JT.transpose();
-        CMatrix pseudoJ(doF,eqNumb);
-        CMatrix JJTInv(mainMatrix*JT);
-        if (!JJTInv.inverse())
+    if (fixedSolve!=nullptr)
+    { // also takes the joint weights into account (part2)
+        if (!fixedSolve(mainMatrix,mainErrorVector,weightCoeffs,calculationMethod,dlsFactor,solution))
             return(-1);
-        pseudoJ=JT*JJTInv;
-        solution=pseudoJ*mainErrorVector;
     }
-    if (calculationMethod==sim_ik_damped_least_squares_method)
-    {
-        CMatrix JT(mainMatrix);
-        JT.transpose();
-        CMatrix DLSJ(doF,eqNumb);
-        CMatrix JJTInv(mainMatrix*JT);
-        CMatrix ID(mainMatrix.rows,mainMatrix.rows);
-        ID.setIdentity();
-        ID/=simReal(1.0)/(dlsFactor*dlsFactor);
-        JJTInv+=ID;
-        if (!JJTInv.inverse())
-            return(-1);
-        DLSJ=JT*JJTInv;
-        solution=DLSJ*mainErrorVector;
-    }
-    if (calculationMethod==sim_ik_jacobian_transpose_method)
+    else
     {
-        CMatrix JT(mainMatrix);
-        JT.transpose();
-        solution=JT*mainErrorVector;
-    }
+        if ( (calculationMethod==sim_ik_pseudo_inverse_method)||(calculationMethod==sim_ik_damped_least_squares_method) )
+        { // solution=JT*y, with (J*JT+damping)*y=e solved by LDLT factorization (no explicit inverse)
+            simReal* jjt=_workspace.jjt.data();
+            simReal* rhs=_workspace.jjtRhs.data();
+            for (size_t i=0;i<eqNumb;i++)
+            {
+                for (size_t j=0;j<=i;j++)
+                {
+                    simReal v=simZero;
+                    for (size_t k=0;k<doF;k++)
+                        v+=mainMatrix[i*doF+k]*mainMatrix[j*doF+k];
+                    jjt[i*eqNumb+j]=v;
+                }
+                rhs[i]=mainErrorVector[i];
+            }
+            if (calculationMethod==sim_ik_damped_least_squares_method)
+            {
+                for (size_t i=0;i<eqNumb;i++)
+                    jjt[i*eqNumb+i]+=dlsFactor*dlsFactor;
+            }
+            if (!CIkRoutines::solveSymmetricSystem(jjt,eqNumb,rhs))
+                return(-1);
+            for (size_t k=0;k<doF;k++)
+            {
+                simReal v=simZero;
+                for (size_t i=0;i<eqNumb;i++)
+                    v+=mainMatrix[i*doF+k]*rhs[i];
+                solution[k]=v;
+            }
+        }
+        if (calculationMethod==sim_ik_jacobian_transpose_method)
+        {
+            for (size_t k=0;k<doF;k++)
+            {
+                simReal v=simZero;
+                for (size_t i=0;i<eqNumb;i++)
+                    v+=mainMatrix[i*doF+k]*mainErrorVector[i];
+                solution[k]=v;
+            }
+        }
 
-    // We take the joint weights into account here (part2):
-    for (size_t i=0;i<doF;i++)
-    {
-        CJoint* it=allJoints[i];
-        simReal coeff=sqrt(fabs(it->getIkWeight()));
-        solution(i,0)=solution(i,0)*coeff;
+        // We take the joint weights into account here (part2):
+        for (size_t i=0;i<doF;i++)
+        {
+            CJoint* it=allJoints[i];
+            simReal coeff=sqrt(fabs(it->getIkWeight()));
+            solution[i]=solution[i]*coeff;
+        }
     }
 
     // We check if some variations are too big:
@@ -892,8 +1047,8 @@ int CikGroup::performOnePass(std::vector<CikElement*>* validElements,bool& limit
         {
             CJoint* it=allJoints[i];
             if (it->getJointType()!=sim_joint_prismatic_subtype)
-                solution(i,0)=atan2(sin(solution(i,0)),cos(solution(i,0)));
-            if (fabs(solution(i,0))>it->getMaxStepSize())
+                solution[i]=atan2(sin(solution[i]),cos(solution[i]));
+            if (fabs(solution[i])>it->getMaxStepSize())
                 return(0);
         }
     }
@@ -903,9 +1058,9 @@ int CikGroup::performOnePass(std::vector<CikElement*>* validElements,bool& limit
         CJoint* it=allJoints[i];
         size_t stage=allJointStages[i];
         if (it->getJointType()!=sim_joint_spherical_subtype)
-            it->setPosition(it->getPosition(true)+solution(i,0),true);
+            it->setPosition(it->getPosition(true)+solution[i],true);
         else
-            it->setTempParameterEx(it->getTempParameterEx(stage)+solution(i,0),stage);
+            it->setTempParameterEx(it->getTempParameterEx(stage)+solution[i],stage);
     }
     return(1);
 }
@@ -913,41 +1068,21 @@ int CikGroup::performOnePass(std::vector<CikElement*>* validElements,bool& limit
 bool CikGroup::computeOnlyJacobian(int options)
 {
     // Now we prepare a vector with all valid and active elements:
-    std::vector<CikElement*> validElements;
+    std::vector<CikElement*>& validElements=_workspace.validElements;
+    validElements.clear();
 
     for (size_t elNb=0;elNb<ikElements.size();elNb++)
     {
         CikElement* element=ikElements[elNb];
-        CDummy* tooltip=App::currentInstance->objectContainer->getDummy(element->getTipHandle());
-        CSceneObject* base=App::currentInstance->objectContainer->getObject(element->getBaseHandle());
+        const CikChainPlan* plan=element->getChainPlan();
         bool valid=true;
         if (!element->getIsActive())
             valid=false;
-        if (tooltip==nullptr)
+        if (plan->tip==nullptr)
             valid=false; // should normally never happen!
-        // We check that tooltip is parented with base and has at least one joint in-between:
+        // We check that tooltip is parented with base and has at least one IK joint in-between:
         if (valid)
-        {
-            valid=false;
-            bool jointPresent=false;
-            bool baseOk=false;
-            CSceneObject* iterat=tooltip;
-            while ( (iterat!=base)&&(iterat!=nullptr) )
-            {
-                iterat=iterat->getParentObject();
-                if (iterat==base)
-                {
-                    baseOk=true;
-                    if (jointPresent)
-                        valid=true;
-                }
-                if ( (iterat!=base)&&(iterat!=nullptr)&&(iterat->getObjectType()==sim_object_joint_type) )
-                {
-                    if ( ((static_cast<CJoint*>(iterat))->getJointMode()==sim_jointmode_ik)||((static_cast<CJoint*>(iterat))->getJointMode()==sim_jointmode_reserved_previously_ikdependent)||((static_cast<CJoint*>(iterat))->getJointMode()==sim_jointmode_dependent) )
-                        jointPresent=true;
-                }
-            }
-        }
+            valid=( plan->baseOk&&(plan->doF!=0) );
         if (valid)
             validElements.push_back(element);
     }
@@ -956,7 +1091,8 @@ bool CikGroup::computeOnlyJacobian(int options)
     if (validElements.size()==0)
         return(false); // error
 
-    _resetTemporaryParameters();
+    _prepareJointFootprint();
+    _resetTemporaryParameters(nullptr,nullptr);
 
     // Here we prepare all element equations:
     for (size_t elNb=0;elNb<validElements.size();elNb++)
@@ -970,73 +1106,38 @@ bool CikGroup::computeOnlyJacobian(int options)
 bool CikGroup::performOnePass_jacobianOnly(std::vector<CikElement*>* validElements,int options)
 {
     // We prepare a vector of all used joints and a counter for the number of rows:
-    std::vector<CJoint*> allJoints;
-    std::vector<size_t> allJointStages;
+    _prepareColumnMap(*validElements);
+    std::vector<CJoint*>& allJoints=_workspace.allJoints;
     size_t numberOfRows=0;
     for (size_t elNb=0;elNb<validElements->size();elNb++)
-    {
-        CikElement* element=validElements->at(elNb);
-        numberOfRows+=element->matrix->rows;
-        for (size_t i=0;i<element->rowJointHandles->size();i++)
-        {
-            int current=element->rowJointHandles->at(i);
-            size_t currentStage=element->rowJointStages->at(i);
-            // We check if that joint is already present:
-            bool present=false;
-            for (size_t j=0;j<allJoints.size();j++)
-            {
-                if ( (allJoints[j]->getObjectHandle()==current)&&(allJointStages[j]==currentStage) )
-                {
-                    present=true;
-                    break;
-                }
-            }
-            if (!present)
-            {
-                allJoints.push_back(App::currentInstance->objectContainer->getJoint(current));
-                allJointStages.push_back(currentStage);
-            }
-        }
-    }
+        numberOfRows+=validElements->at(elNb)->matrix->rows;
 
     // Now we prepare the individual joint constraints part:
-    for (size_t i=0;i<allJoints.size();i++)
-    {
-        if (allJoints[i]->getJointType()!=sim_joint_spherical_subtype)
-        {
-            if ( (allJoints[i]->getJointMode()==sim_jointmode_reserved_previously_ikdependent)||(allJoints[i]->getJointMode()==sim_jointmode_dependent) )
-                numberOfRows++;
-        }
-    }
+    numberOfRows+=_workspace.dependentColumns.size();
 
-    // We prepare the main matrix and the main error vector.
-    CMatrix mainMatrix(numberOfRows,allJoints.size());
-    CMatrix mainMatrix_correctJacobian(numberOfRows,allJoints.size());
-    // We have to zero it first:
-    mainMatrix.clear();
-    mainMatrix_correctJacobian.clear();
-    CMatrix mainErrorVector(numberOfRows,1);
+    // We prepare the main matrix and the main error vector (zeroed):
+    _workspace.prepareMainSystem(numberOfRows,allJoints.size());
+    size_t doF=_workspace.doF;
+    simReal* mainMatrix=_workspace.mainMatrix.data();
+    simReal* mainMatrix_correctJacobian=_workspace.mainMatrix_correctJacobian.data();
+    simReal* mainErrorVector=_workspace.mainErrorVector.data();
 
     // Now we fill in the main matrix and the main error vector:
     size_t currentRow=0;
     for (size_t elNb=0;elNb<validElements->size();elNb++)
     {
         CikElement* element=validElements->at(elNb);
+        const size_t* columns=_workspace.elementColumns.data()+_workspace.elementColumnOffsets[elNb];
         for (size_t i=0;i<element->errorVector->rows;i++)
         { // We go through the rows:
             // We first set the error part:
-            mainErrorVector(currentRow,0)=(*element->errorVector)(i,0);
+            mainErrorVector[currentRow]=(*element->errorVector)(i,0);
             // Now we set the delta-parts:
             for (size_t j=0;j<element->matrix->cols;j++)
             { // We go through the columns:
-                // We search for the right entry
-                int jointHandle=element->rowJointHandles->at(j);
-                size_t stage=element->rowJointStages->at(j);
-                size_t index=0;
-                while ( (allJoints[index]->getObjectHandle()!=jointHandle)||(allJointStages[index]!=stage) )
-                    index++;
-                mainMatrix(currentRow,index)=(*element->matrix)(i,j);
-                mainMatrix_correctJacobian(currentRow,index)=(*element->matrix_correctJacobian)(i,j);
+                size_t index=columns[j];
+                mainMatrix[currentRow*doF+index]=(*element->matrix)(i,j);
+                mainMatrix_correctJacobian[currentRow*doF+index]=(*element->matrix_correctJacobian)(i,j);
             }
             currentRow++;
         }
@@ -1044,78 +1145,69 @@ bool CikGroup::performOnePass_jacobianOnly(std::vector<CikElement*>* validElemen
 
     // Now we prepare the individual joint constraints part:
     //---------------------------------------------------------------------------
-    for (size_t i=0;i<allJoints.size();i++)
+    for (size_t k=0;k<_workspace.dependentColumns.size();k++)
     {
-        if ( ((allJoints[i]->getJointMode()==sim_jointmode_dependent)||(allJoints[i]->getJointMode()==sim_jointmode_reserved_previously_ikdependent))&&(allJoints[i]->getJointType()!=sim_joint_spherical_subtype) )
+        size_t i=_workspace.dependentColumns[k];
+        int dependenceID=allJoints[i]->getDependencyJointHandle();
+        if (dependenceID!=-1)
         {
-            int dependenceID=allJoints[i]->getDependencyJointHandle();
-            if (dependenceID!=-1)
+            int depJointColumn=_workspace.dependentMasterColumns[k];
+            if (depJointColumn!=-1)
             {
-                bool found=false;
-                size_t depJointIndex;
-                for (depJointIndex=0;depJointIndex<allJoints.size();depJointIndex++)
-                {
-                    if (allJoints[depJointIndex]->getObjectHandle()==dependenceID)
-                    {
-                        found=true;
-                        break;
-                    }
-                }
-                if (found)
+                size_t depJointIndex=size_t(depJointColumn);
+                simReal coeff=allJoints[i]->getDependencyJointMult();
+                simReal fact=allJoints[i]->getDependencyJointAdd();
+                mainErrorVector[currentRow]=((allJoints[i]->getPosition(true)-fact)-
+                                coeff*allJoints[depJointIndex]->getPosition(true));
+                mainMatrix[currentRow*doF+i]=-simOne;
+                mainMatrix[currentRow*doF+depJointIndex]=coeff;
+                mainMatrix_correctJacobian[currentRow*doF+i]=-simOne;
+                mainMatrix_correctJacobian[currentRow*doF+depJointIndex]=coeff;
+            }
+            else
+            {   // joint of dependenceID is not part of this group calculation:
+                // therefore we take its current value --> WRONG! Since all temp params are initialized!
+                CJoint* dependentJoint=App::currentInstance->objectContainer->getJoint(dependenceID);
+                if (dependentJoint!=nullptr)
                 {
                     simReal coeff=allJoints[i]->getDependencyJointMult();
                     simReal fact=allJoints[i]->getDependencyJointAdd();
-                    mainErrorVector(currentRow,0)=((allJoints[i]->getPosition(true)-fact)-
-                                    coeff*allJoints[depJointIndex]->getPosition(true));
-                    mainMatrix(currentRow,i)=-simOne;
-                    mainMatrix(currentRow,depJointIndex)=coeff;
-                    mainMatrix_correctJacobian(currentRow,i)=-simOne;
-                    mainMatrix_correctJacobian(currentRow,depJointIndex)=coeff;
-                }
-                else
-                {   // joint of dependenceID is not part of this group calculation:
-                    // therefore we take its current value --> WRONG! Since all temp params are initialized!
-                    CJoint* dependentJoint=App::currentInstance->objectContainer->getJoint(dependenceID);
-                    if (dependentJoint!=nullptr)
-                    {
-                        simReal coeff=allJoints[i]->getDependencyJointMult();
-                        simReal fact=allJoints[i]->getDependencyJointAdd();
-                        mainErrorVector(currentRow,0)=((allJoints[i]->getPosition(true)-fact)-
-                                        coeff*dependentJoint->getPosition(true));
-                        mainMatrix(currentRow,i)=-simOne;
-                        mainMatrix_correctJacobian(currentRow,i)=-simOne;
-                    }
+                    mainErrorVector[currentRow]=((allJoints[i]->getPosition(true)-fact)-
+                                    coeff*dependentJoint->getPosition(true));
+                    mainMatrix[currentRow*doF+i]=-simOne;
+                    mainMatrix_correctJacobian[currentRow*doF+i]=-simOne;
                 }
             }
-            else
-            {
-                mainErrorVector(currentRow,0)=(allJoints[i]->getPosition(true)-allJoints[i]->getDependencyJointAdd());
-                mainMatrix(currentRow,i)=-simOne;
-                mainMatrix_correctJacobian(currentRow,i)=-simOne;
-            }
-            currentRow++;
         }
+        else
+        {
+            mainErrorVector[currentRow]=(allJoints[i]->getPosition(true)-allJoints[i]->getDependencyJointAdd());
+            mainMatrix[currentRow*doF+i]=-simOne;
+            mainMatrix_correctJacobian[currentRow*doF+i]=-simOne;
+        }
+        currentRow++;
     }
 
     if ((options&1)!=0)
     { // We take the joint weights into account here (part1):
-        for (size_t i=0;i<mainMatrix.rows;i++)
+        for (size_t j=0;j<doF;j++)
         {
-            for (size_t j=0;j<allJoints.size();j++)
+            simReal coeff=allJoints[j]->getIkWeight();
+            if (coeff>=simZero)
+                coeff=sqrt(coeff);
+            else
+                coeff=-sqrt(-coeff);
+            for (size_t i=0;i<numberOfRows;i++)
             {
-                simReal coeff=allJoints[j]->getIkWeight();
-                if (coeff>=simZero)
-                    coeff=sqrt(coeff);
-                else
-                    coeff=-sqrt(-coeff);
-                mainMatrix(i,j)=mainMatrix(i,j)*coeff;
-                mainMatrix_correctJacobian(i,j)=mainMatrix_correctJacobian(i,j)*coeff;
+                mainMatrix[i*doF+j]*=coeff;
+                mainMatrix_correctJacobian[i*doF+j]*=coeff;
             }
         }
     }
 
-    delete _lastJacobian;
-    _lastJacobian=new CMatrix(mainMatrix_correctJacobian);
+    CIkRoutines::reserveMatrix(_lastJacobian,numberOfRows,doF);
+    for (size_t i=0;i<numberOfRows*doF;i++)
+        _lastJacobian->data[i]=mainMatrix_correctJacobian[i];
 
     return(true);
 }
@@ -1239,10 +1331,64 @@ void CikGroup::serialize(CSerialization &ar)
     _correctJointLimits=SIM_IS_BIT_SET(nothing,0);
 
     int el=ar.readInt();
-    for (int i=0;i<el;i++)
+    for (int i=0;(i<el)&&(!ar.hasFailed());i++)
     {
         CikElement* it=new CikElement(-1);
         it->serialize(ar);
         ikElements.push_back(it);
     }
 }
+
+void CikGroup::writeRecord(SIkGroupRecord& rec) const
+{ // The name is handled by the caller
+    rec.ints[IK_GROUP_HANDLE]=objectID;
+    rec.ints[IK_GROUP_MAX_ITERATIONS]=maxIterations;
+    rec.ints[IK_GROUP_CONSTRAINTS]=constraints;
+    rec.ints[IK_GROUP_CALCULATION_METHOD]=calculationMethod;
+    rec.ints[IK_GROUP_DO_ON_FAIL_OR_SUCCESS_OF]=doOnFailOrSuccessOf;
+    int flags=0;
+    if (active)
+        flags|=1;
+    if (restoreIfPositionNotReached)
+        flags|=2;
+    if (restoreIfOrientationNotReached)
+        flags|=4;
+    if (doOnFail)
+        flags|=8;
+    if (doOnPerformed)
+        flags|=16;
+    if (!ignoreMaxStepSizes)
+        flags|=32;
+    if (_explicitHandling)
+        flags|=64;
+    if (_correctJointLimits)
+        flags|=256;
+    rec.ints[IK_GROUP_FLAGS]=flags;
+    rec.ints[IK_GROUP_ELEMENT_CNT]=int(ikElements.size());
+    rec.reals[IK_GROUP_JOINT_LIMIT_WEIGHT]=jointLimitWeight;
+    rec.reals[IK_GROUP_JOINT_THRESHOLD_ANGULAR]=jointTreshholdAngular;
+    rec.reals[IK_GROUP_JOINT_THRESHOLD_LINEAR]=jointTreshholdLinear;
+    rec.reals[IK_GROUP_DLS_FACTOR]=dlsFactor;
+}
+
+void CikGroup::readRecord(const SIkGroupRecord& rec)
+{ // The name and the IK elements are handled by the caller
+    objectID=rec.ints[IK_GROUP_HANDLE];
+    maxIterations=rec.ints[IK_GROUP_MAX_ITERATIONS];
+    constraints=rec.ints[IK_GROUP_CONSTRAINTS];
+    calculationMethod=rec.ints[IK_GROUP_CALCULATION_METHOD];
+    doOnFailOrSuccessOf=rec.ints[IK_GROUP_DO_ON_FAIL_OR_SUCCESS_OF];
+    int flags=rec.ints[IK_GROUP_FLAGS];
+    active=SIM_IS_BIT_SET(flags,0);
+    restoreIfPositionNotReached=SIM_IS_BIT_SET(flags,1);
+    restoreIfOrientationNotReached=SIM_IS_BIT_SET(flags,2);
+    doOnFail=SIM_IS_BIT_SET(flags,3);
+    doOnPerformed=SIM_IS_BIT_SET(flags,4);
+    ignoreMaxStepSizes=!SIM_IS_BIT_SET(flags,5);
+    _explicitHandling=SIM_IS_BIT_SET(flags,6);
+    _correctJointLimits=SIM_IS_BIT_SET(flags,8);
+    jointLimitWeight=rec.reals[IK_GROUP_JOINT_LIMIT_WEIGHT];
+    jointTreshholdAngular=rec.reals[IK_GROUP_JOINT_THRESHOLD_ANGULAR];
+    jointTreshholdLinear=rec.reals[IK_GROUP_JOINT_THRESHOLD_LINEAR];
+    dlsFactor=rec.reals[IK_GROUP_DLS_FACTOR];
+}
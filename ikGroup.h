@@ -5,6 +5,7 @@
 #include "sceneObject.h"
 #include "joint.h"
 #include "dummy.h"
+#include "ikWorkspace.h"
 
 class CikGroup  
 {
@@ -16,6 +17,9 @@ public:
     bool announceIkGroupWillBeErased(int ikGroupHandle);
     void performObjectLoadingMapping(std::vector<int>* map);
     void serialize(CSerialization& ar);
+    void writeRecord(SIkGroupRecord& rec) const;
+    void readRecord(const SIkGroupRecord& rec);
+    CikGroup* copyYourself() const;
 
     CikElement* getIkElement(int ikElementID) const;
     CikElement* getIkElementWithTooltipID(int tooltipID) const;
@@ -51,8 +55,11 @@ public:
     void setJointTreshholdAngular(simReal t);
     void setJointTreshholdLinear(simReal t);
     int computeGroupIk(bool forInternalFunctionality);
+    int solveGroupIk(const std::vector<CJoint*>& joints,const simReal* initialJointValues,const C7Vector* targetPoses,simReal* jointValues,simReal* residuals,int* iterationCnt);
     void getAllActiveJoints(std::vector<CJoint*>& jointList) const;
     void getTipAndTargetLists(std::vector<CDummy*>& tipList,std::vector<CDummy*>& targetList) const;
+    const std::vector<CJoint*>& getReadJoints();
+    const std::vector<CJoint*>& getTouchedJoints();
 
     bool getIgnoreMaxStepSizes() const;
     void setIgnoreMaxStepSizes(bool ignore);
@@ -73,8 +80,11 @@ public:
     std::vector<CikElement*> ikElements;
 
 private:
-    void _resetTemporaryParameters();
+    int _computeGroupIk(bool forInternalFunctionality,const std::vector<CJoint*>* initialJoints,const simReal* initialJointValues,bool& setNewValues,int& iterationCnt);
+    void _resetTemporaryParameters(const std::vector<CJoint*>* initialJoints,const simReal* initialJointValues);
     void _applyTemporaryParameters();
+    void _prepareJointFootprint();
+    void _prepareColumnMap(const std::vector<CikElement*>& validElements);
 
     int performOnePass(std::vector<CikElement*>* validElements,bool& limitOrAvoidanceNeedMoreCalculation,simReal interpolFact,bool forInternalFunctionality);
     bool performOnePass_jacobianOnly(std::vector<CikElement*>* validElements,int options);
@@ -101,6 +111,7 @@ private:
     int _calculationResult;
 
     CMatrix* _lastJacobian;
+    CikWorkspace _workspace;
 
     bool _explicitHandling;
 };
@@ -2,6 +2,7 @@
 #include "ikRoutines.h"
 #include "app.h"
 #include "simConst.h"
+#include <algorithm>
 
 
 CIkGroupContainer::CIkGroupContainer()
@@ -13,6 +14,14 @@ CIkGroupContainer::~CIkGroupContainer()
     removeAllIkGroups();
 }
 
+CIkGroupContainer* CIkGroupContainer::copyYourself() const
+{
+    CIkGroupContainer* newContainer=new CIkGroupContainer();
+    for (size_t i=0;i<ikGroups.size();i++)
+        newContainer->addIkGroup(ikGroups[i]->copyYourself());
+    return(newContainer);
+}
+
 CikGroup* CIkGroupContainer::getIkGroup(int groupID) const
 {
      for (size_t i=0;i<ikGroups.size();i++)
@@ -25,11 +34,9 @@ CikGroup* CIkGroupContainer::getIkGroup(int groupID) const
 
 CikGroup* CIkGroupContainer::getIkGroup(std::string groupName) const
 {
-    for (size_t i=0;i<ikGroups.size();i++)
-    {
-        if (ikGroups[i]->getObjectName().compare(groupName)==0)
-            return(ikGroups[i]);
-    }
+    std::unordered_map<std::string,CikGroup*>::const_iterator it=_ikGroupsByName.find(groupName);
+    if (it!=_ikGroupsByName.end())
+        return(it->second);
     return(nullptr);
 }
 
@@ -40,8 +47,22 @@ void CIkGroupContainer::removeIkGroup(int ikGroupHandle)
     {
         if (ikGroups[i]->getObjectID()==ikGroupHandle)
         {
-            delete ikGroups[i];
+            CikGroup* it=ikGroups[i];
             ikGroups.erase(ikGroups.begin()+i);
+            std::unordered_map<std::string,CikGroup*>::iterator n=_ikGroupsByName.find(it->getObjectName());
+            if ( (n!=_ikGroupsByName.end())&&(n->second==it) )
+            { // another group might have the same name:
+                _ikGroupsByName.erase(n);
+                for (size_t j=i;j<ikGroups.size();j++)
+                {
+                    if (ikGroups[j]->getObjectName()==it->getObjectName())
+                    {
+                        _ikGroupsByName[it->getObjectName()]=ikGroups[j];
+                        break;
+                    }
+                }
+            }
+            delete it;
             return;
         }
     }
@@ -89,8 +110,10 @@ void CIkGroupContainer::announceIkGroupWillBeErased(int ikGroupHandle)
     }
 }
 
-int CIkGroupContainer::computeAllIkGroups(bool exceptExplicitHandling)
+int CIkGroupContainer::computeAllIkGroups(bool exceptExplicitHandling,size_t workerCnt/*=1*/)
 {
+    if ( (workerCnt>1)&&(ikGroups.size()>1) )
+        return(_scheduler.computeAllIkGroups(ikGroups,exceptExplicitHandling,std::min<size_t>(workerCnt,ikGroups.size())));
     int performedCount=0;
     {
         for (size_t i=0;i<ikGroups.size();i++)
@@ -111,4 +134,5 @@ int CIkGroupContainer::computeAllIkGroups(bool exceptExplicitHandling)
 void CIkGroupContainer::addIkGroup(CikGroup* anIkGroup)
 { // Be careful! We don't check if the group is valid!!
     ikGroups.push_back(anIkGroup);
+    _ikGroupsByName.insert(std::make_pair(anIkGroup->getObjectName(),anIkGroup)); // does nothing if the name is already used
 }
@@ -2,7 +2,9 @@
 
 #include "ik.h"
 #include <vector>
+#include <unordered_map>
 #include "ikGroup.h"
+#include "ikGroupScheduler.h"
 
 class CIkGroupContainer
 {
@@ -17,8 +19,13 @@ public:
     void removeAllIkGroups();
     void announceSceneObjectWillBeErased(int objectHandle);
     void announceIkGroupWillBeErased(int ikGroupHandle);
-    int computeAllIkGroups(bool exceptExplicitHandling);
+    int computeAllIkGroups(bool exceptExplicitHandling,size_t workerCnt=1);
     void resetCalculationResults();
+    CIkGroupContainer* copyYourself() const;
 
     std::vector<CikGroup*> ikGroups;
+
+private:
+    std::unordered_map<std::string,CikGroup*> _ikGroupsByName; // first group (in ikGroups) with that name
+    CIkGroupScheduler _scheduler; // for computeAllIkGroups with several workers
 };
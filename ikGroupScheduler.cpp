@@ -0,0 +1,257 @@
+#include "ikGroupScheduler.h"
+#include "app.h"
+#include "simConst.h"
+#include <algorithm>
+
+CIkGroupScheduler::CIkGroupScheduler()
+{
+    _topologyVersion=0;
+    _remainingGroups=0;
+    _busyThreads=0;
+    _runWorkerCnt=0;
+    _run=0;
+    _environment=nullptr;
+    _environmentHandle=0;
+    _exceptExplicitHandling=false;
+    _performedCount=0;
+    _quit=false;
+}
+
+CIkGroupScheduler::~CIkGroupScheduler()
+{
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _quit=true;
+    }
+    _runCondition.notify_all();
+    for (size_t i=0;i<_threads.size();i++)
+        _threads[i].join();
+}
+
+int CIkGroupScheduler::computeAllIkGroups(const std::vector<CikGroup*>& groups,bool exceptExplicitHandling,size_t workerCnt)
+{ // In the current environment. The calling thread is one of the workers
+    if (!_isGraphUpToDate(groups))
+        _buildGraph(groups);
+    while (_threads.size()+1<workerCnt)
+        _threads.push_back(std::thread(&CIkGroupScheduler::_workerThread,this,_threads.size()+1,_run));
+
+    // Cached temp. poses are filled lazily. Those of objects not below a joint can be shared by several groups, and are
+    // filled here, before the groups run:
+    for (size_t i=0;i<_groups.size();i++)
+    {
+        for (size_t elNb=0;elNb<_groups[i]->ikElements.size();elNb++)
+        {
+            CikElement* element=_groups[i]->ikElements[elNb];
+            int handles[4]={element->getTipHandle(),element->getTargetHandle(),element->getBaseHandle(),element->getAltBaseHandleForConstraints()};
+            for (size_t j=0;j<4;j++)
+            {
+                CSceneObject* it=App::currentInstance->objectContainer->getObject(handles[j]);
+                if (it!=nullptr)
+                    it->getCumulativeTransformation(true);
+            }
+        }
+    }
+
+    App::currentInstance->objectContainer->setConcurrentAccess(true);
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _environment=App::currentInstance;
+        _environmentHandle=App::currentInstanceHandle;
+        _exceptExplicitHandling=exceptExplicitHandling;
+        _performedCount=0;
+        _runWorkerCnt=workerCnt;
+        _readyGroups.resize(workerCnt);
+        for (size_t i=0;i<workerCnt;i++)
+            _readyGroups[i].clear();
+        _remainingPredecessors=_predecessorCnts;
+        _remainingGroups=_groups.size();
+        size_t worker=0;
+        for (size_t i=_groups.size();i>0;i--)
+        { // Distributed in reverse order, since a worker first takes the last group it was given
+            if (_predecessorCnts[i-1]==0)
+            {
+                _readyGroups[worker].push_back(i-1);
+                worker=(worker+1)%workerCnt;
+            }
+        }
+        _busyThreads=workerCnt-1;
+        _run++;
+    }
+    _runCondition.notify_all();
+    _work(0);
+    int retVal;
+    {
+        std::unique_lock<std::mutex> lock(_mutex);
+        while (_busyThreads>0)
+            _readyCondition.wait(lock);
+        retVal=_performedCount;
+    }
+    App::currentInstance->objectContainer->setConcurrentAccess(false);
+    return(retVal);
+}
+
+bool CIkGroupScheduler::_isGraphUpToDate(const std::vector<CikGroup*>& groups) const
+{
+    if ( (_groups!=groups)||(_topologyVersion!=App::currentInstance->objectContainer->getTopologyVersion()) )
+        return(false);
+    std::vector<int> signature;
+    _getGraphSignature(groups,signature);
+    return(signature==_signature);
+}
+
+void CIkGroupScheduler::_getGraphSignature(const std::vector<CikGroup*>& groups,std::vector<int>& signature)
+{
+    signature.clear();
+    for (size_t i=0;i<groups.size();i++)
+    {
+        signature.push_back(groups[i]->getObjectID());
+        signature.push_back(groups[i]->getDoOnFailOrSuccessOf());
+        signature.push_back(int(groups[i]->ikElements.size()));
+        for (size_t elNb=0;elNb<groups[i]->ikElements.size();elNb++)
+        {
+            CikElement* element=groups[i]->ikElements[elNb];
+            signature.push_back(element->getTipHandle());
+            signature.push_back(element->getTargetHandle());
+            signature.push_back(element->getBaseHandle());
+            signature.push_back(element->getAltBaseHandleForConstraints());
+        }
+    }
+}
+
+void CIkGroupScheduler::_buildGraph(const std::vector<CikGroup*>& groups)
+{
+    _groups=groups;
+    _getGraphSignature(groups,_signature);
+    _topologyVersion=App::currentInstance->objectContainer->getTopologyVersion();
+    size_t groupCnt=groups.size();
+
+    // The joints a group touches, sorted by handle:
+    std::vector<std::vector<int> > touchedJoints(groupCnt);
+    for (size_t i=0;i<groupCnt;i++)
+    {
+        const std::vector<CJoint*>& joints=groups[i]->getTouchedJoints();
+        for (size_t j=0;j<joints.size();j++)
+            touchedJoints[i].push_back(joints[j]->getObjectHandle());
+        std::sort(touchedJoints[i].begin(),touchedJoints[i].end());
+    }
+
+    _successors.assign(groupCnt,std::vector<size_t>());
+    _predecessorCnts.assign(groupCnt,0);
+    for (size_t j=0;j<groupCnt;j++)
+    {
+        for (size_t i=0;i<j;i++)
+        {
+            bool conditional=( (groups[j]->getDoOnFailOrSuccessOf()==groups[i]->getObjectID())||(groups[i]->getDoOnFailOrSuccessOf()==groups[j]->getObjectID()) );
+            if ( conditional||_intersect(touchedJoints[i],touchedJoints[j]) )
+            {
+                _successors[i].push_back(j);
+                _predecessorCnts[j]++;
+            }
+        }
+    }
+}
+
+bool CIkGroupScheduler::_intersect(const std::vector<int>& sortedA,const std::vector<int>& sortedB)
+{
+    size_t a=0;
+    size_t b=0;
+    while ( (a<sortedA.size())&&(b<sortedB.size()) )
+    {
+        if (sortedA[a]==sortedB[b])
+            return(true);
+        if (sortedA[a]<sortedB[b])
+            a++;
+        else
+            b++;
+    }
+    return(false);
+}
+
+void CIkGroupScheduler::_workerThread(size_t workerIndex,unsigned long long lastRun)
+{ // Pool thread. Sleeps between runs, and skips the runs that use fewer workers
+    std::unique_lock<std::mutex> lock(_mutex);
+    while (true)
+    {
+        while ( (!_quit)&&(_run==lastRun) )
+            _runCondition.wait(lock);
+        if (_quit)
+            break;
+        lastRun=_run;
+        if (workerIndex<_runWorkerCnt)
+        {
+            App::currentInstance=_environment;
+            App::currentInstanceHandle=_environmentHandle;
+            lock.unlock();
+            _work(workerIndex);
+            lock.lock();
+            App::currentInstance=nullptr;
+            App::currentInstanceHandle=0;
+            _busyThreads--;
+            if (_busyThreads==0)
+                _readyCondition.notify_all();
+        }
+    }
+}
+
+void CIkGroupScheduler::_work(size_t workerIndex)
+{
+    size_t groupIndex;
+    while (_takeGroup(workerIndex,groupIndex))
+        _computeGroup(groupIndex,workerIndex);
+}
+
+bool CIkGroupScheduler::_takeGroup(size_t workerIndex,size_t& groupIndex)
+{ // Blocks until a group is ready. Returns false once all groups were computed
+    std::unique_lock<std::mutex> lock(_mutex);
+    while (_remainingGroups>0)
+    {
+        std::deque<size_t>& own=_readyGroups[workerIndex];
+        if (own.size()>0)
+        {
+            groupIndex=own.back();
+            own.pop_back();
+            return(true);
+        }
+        for (size_t i=1;i<_runWorkerCnt;i++)
+        {
+            std::deque<size_t>& other=_readyGroups[(workerIndex+i)%_runWorkerCnt];
+            if (other.size()>0)
+            {
+                groupIndex=other.front();
+                other.pop_front();
+                return(true);
+            }
+        }
+        _readyCondition.wait(lock);
+    }
+    return(false);
+}
+
+void CIkGroupScheduler::_computeGroup(size_t groupIndex,size_t workerIndex)
+{
+    CikGroup* group=_groups[groupIndex];
+    bool performed=false;
+    if ((!_exceptExplicitHandling)||(!group->getExplicitHandling()))
+    {
+        int res=group->computeGroupIk(false);
+        group->setCalculationResult(res);
+        performed=(res!=sim_ikresult_not_performed);
+    }
+    std::lock_guard<std::mutex> lock(_mutex);
+    if (performed)
+        _performedCount++;
+    _remainingGroups--;
+    bool notify=(_remainingGroups==0);
+    for (size_t i=0;i<_successors[groupIndex].size();i++)
+    {
+        size_t successor=_successors[groupIndex][i];
+        _remainingPredecessors[successor]--;
+        if (_remainingPredecessors[successor]==0)
+        {
+            _readyGroups[workerIndex].push_back(successor);
+            notify=true;
+        }
+    }
+    if (notify)
+        _readyCondition.notify_all();
+}
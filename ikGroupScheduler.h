@@ -0,0 +1,56 @@
+#pragma once
+
+#include "ik.h"
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+class App;
+class CikGroup;
+
+class CIkGroupScheduler
+{ // Computes the IK groups of a container on several threads. A group waits for an earlier group (in container order) if
+  // both touch a same joint, or if one is conditionally executed depending on the other. Other groups run concurrently,
+  // which gives the same results as computing them one after the other
+public:
+    CIkGroupScheduler();
+    virtual ~CIkGroupScheduler();
+
+    int computeAllIkGroups(const std::vector<CikGroup*>& groups,bool exceptExplicitHandling,size_t workerCnt);
+
+private:
+    bool _isGraphUpToDate(const std::vector<CikGroup*>& groups) const;
+    void _buildGraph(const std::vector<CikGroup*>& groups);
+    static void _getGraphSignature(const std::vector<CikGroup*>& groups,std::vector<int>& signature);
+    static bool _intersect(const std::vector<int>& sortedA,const std::vector<int>& sortedB);
+    void _workerThread(size_t workerIndex,unsigned long long lastRun);
+    void _work(size_t workerIndex);
+    bool _takeGroup(size_t workerIndex,size_t& groupIndex);
+    void _computeGroup(size_t groupIndex,size_t workerIndex);
+
+    // Dependency graph, rebuilt when the topology or a group's elements changed:
+    std::vector<CikGroup*> _groups;
+    std::vector<int> _signature; // group handles, conditional execution, and element tip/target/base handles
+    unsigned int _topologyVersion;
+    std::vector<std::vector<size_t> > _successors;
+    std::vector<size_t> _predecessorCnts;
+
+    // Current run. Protected by _mutex:
+    std::mutex _mutex;
+    std::condition_variable _runCondition; // pool threads wait for a run
+    std::condition_variable _readyCondition; // workers wait for ready groups, the caller for the end of the run
+    std::vector<std::deque<size_t> > _readyGroups; // by worker. A worker takes from the back of its own deque, and steals from the front of others
+    std::vector<size_t> _remainingPredecessors;
+    size_t _remainingGroups;
+    size_t _busyThreads; // pool threads not yet done with the current run
+    size_t _runWorkerCnt; // caller included
+    unsigned long long _run;
+    App* _environment;
+    int _environmentHandle;
+    bool _exceptExplicitHandling;
+    int _performedCount;
+    bool _quit;
+    std::vector<std::thread> _threads; // worker i is _threads[i-1]. The caller is worker 0
+};
@@ -0,0 +1,295 @@
+#pragma once
+
+#include "ik.h"
+#include "MyMath.h"
+
+#if (!defined(IK_SCALAR_KERNELS))&&(!defined(SIM_MATH_DOUBLE))&&(defined(__SSE2__)||defined(_M_X64))
+    #define IK_SSE_KERNELS
+    #include <immintrin.h>
+#elif (!defined(IK_SCALAR_KERNELS))&&defined(SIM_MATH_DOUBLE)&&defined(__AVX2__)
+    #define IK_AVX2_KERNELS
+    #include <immintrin.h>
+#endif
+
+class CIkKernels
+{ // Transformation kernels of the IK hot path, vectorized with SSE (float) or AVX2 (double). With IK_SCALAR_KERNELS
+  // defined, or on other targets, they use the simMath operators instead, e.g. to compare results bit by bit.
+  // Quaternions don't need to be normalized, i.e. rotations give q*v*q^-1 scaled by |q|^2, as C4Vector does.
+  // Defined here, so that they are inlined in the calling loops
+public:
+    static void multiply(const C4X4FullMatrix& a,const C4X4FullMatrix& b,C4X4FullMatrix& result); // result=a*b. result can be a or b
+    static void addProduct(const C4X4FullMatrix& a,const C4X4FullMatrix& b,C4X4FullMatrix& result); // result+=a*b. result can't be a or b
+    static C4Vector multiply(const C4Vector& a,const C4Vector& b);
+    static C7Vector multiply(const C7Vector& a,const C7Vector& b);
+    static C7Vector multiplyInChain(const C7Vector& a,const C7Vector& b); // for chained products, e.g. cumulative transformations
+    static C7Vector getInverse(const C7Vector& tr);
+    static C3Vector rotate(const C4Vector& q,const C3Vector& v);
+    static C3Vector transform(const C7Vector& tr,const C3Vector& v);
+    static const char* getImplementation();
+
+private:
+#if defined(IK_SSE_KERNELS)
+    static __m128 _load3(const C3Vector& v);
+    static C3Vector _store3(__m128 v);
+    static __m128 _cross(__m128 a,__m128 b);
+    static __m128 _dot(__m128 a,__m128 b);
+    static __m128 _rotate(__m128 q,__m128 v,__m128 offset);
+    static __m128 _multiplyQuaternions(__m128 a,__m128 b);
+    static __m128 _multiplyRow(const C4X4FullMatrix& a,size_t row,const __m128* b);
+#elif defined(IK_AVX2_KERNELS)
+    static __m256d _load3(const C3Vector& v);
+    static C3Vector _store3(__m256d v);
+    static __m256d _cross(__m256d a,__m256d b);
+    static __m256d _dot(__m256d a,__m256d b);
+    static __m256d _rotate(__m256d q,__m256d v,__m256d offset);
+    static __m256d _multiplyQuaternions(__m256d a,__m256d b);
+    static __m256d _multiplyRow(const C4X4FullMatrix& a,size_t row,const __m256d* b);
+#endif
+};
+
+// Rotations use v'=(w*w-u.u)*v+2*(u.v)*u+2*w*(u^v), with u the vector part of q, like the batch kernels of
+// CKinematicModel. The quaternion product, and the 3-vector dot and cross products are done with lane shuffles.
+// Lane 3 of 3-vectors is zero
+#ifdef IK_SSE_KERNELS
+inline __m128 CIkKernels::_load3(const C3Vector& v)
+{
+    return(_mm_set_ps(simZero,v(2),v(1),v(0)));
+}
+
+inline C3Vector CIkKernels::_store3(__m128 v)
+{
+    simReal r[4];
+    _mm_storeu_ps(r,v);
+    return(C3Vector(r[0],r[1],r[2]));
+}
+
+inline __m128 CIkKernels::_cross(__m128 a,__m128 b)
+{ // (a*b.yzx-a.yzx*b).yzx
+    __m128 aYzx=_mm_shuffle_ps(a,a,_MM_SHUFFLE(3,0,2,1));
+    __m128 bYzx=_mm_shuffle_ps(b,b,_MM_SHUFFLE(3,0,2,1));
+    __m128 c=_mm_sub_ps(_mm_mul_ps(a,bYzx),_mm_mul_ps(aYzx,b));
+    return(_mm_shuffle_ps(c,c,_MM_SHUFFLE(3,0,2,1)));
+}
+
+inline __m128 CIkKernels::_dot(__m128 a,__m128 b)
+{ // a.b in all lanes
+    __m128 p=_mm_mul_ps(a,b);
+    p=_mm_add_ps(p,_mm_shuffle_ps(p,p,_MM_SHUFFLE(1,0,3,2)));
+    return(_mm_add_ps(p,_mm_shuffle_ps(p,p,_MM_SHUFFLE(2,3,0,1))));
+}
+
+inline __m128 CIkKernels::_rotate(__m128 q,__m128 v,__m128 offset)
+{ // offset+q*v
+    __m128 u=_mm_and_ps(_mm_shuffle_ps(q,q,_MM_SHUFFLE(0,3,2,1)),_mm_castsi128_ps(_mm_set_epi32(0,-1,-1,-1)));
+    __m128 w=_mm_shuffle_ps(q,q,_MM_SHUFFLE(0,0,0,0));
+    __m128 uv=_dot(u,v);
+    __m128 r=_mm_mul_ps(_mm_sub_ps(_mm_mul_ps(w,w),_dot(u,u)),v);
+    r=_mm_add_ps(r,_mm_mul_ps(_mm_add_ps(uv,uv),u));
+    r=_mm_add_ps(r,_mm_mul_ps(_mm_add_ps(w,w),_cross(u,v)));
+    return(_mm_add_ps(offset,r));
+}
+
+inline __m128 CIkKernels::_multiplyQuaternions(__m128 a,__m128 b)
+{
+    __m128 p1=_mm_xor_ps(_mm_shuffle_ps(b,b,_MM_SHUFFLE(2,3,0,1)),_mm_set_ps(simZero,-simZero,simZero,-simZero));
+    __m128 p2=_mm_xor_ps(_mm_shuffle_ps(b,b,_MM_SHUFFLE(1,0,3,2)),_mm_set_ps(-simZero,simZero,simZero,-simZero));
+    __m128 p3=_mm_xor_ps(_mm_shuffle_ps(b,b,_MM_SHUFFLE(0,1,2,3)),_mm_set_ps(simZero,simZero,-simZero,-simZero));
+    __m128 r=_mm_mul_ps(_mm_shuffle_ps(a,a,_MM_SHUFFLE(0,0,0,0)),b);
+    r=_mm_add_ps(r,_mm_mul_ps(_mm_shuffle_ps(a,a,_MM_SHUFFLE(1,1,1,1)),p1));
+    r=_mm_add_ps(r,_mm_mul_ps(_mm_shuffle_ps(a,a,_MM_SHUFFLE(2,2,2,2)),p2));
+    return(_mm_add_ps(r,_mm_mul_ps(_mm_shuffle_ps(a,a,_MM_SHUFFLE(3,3,3,3)),p3)));
+}
+
+inline __m128 CIkKernels::_multiplyRow(const C4X4FullMatrix& a,size_t row,const __m128* b)
+{
+    __m128 r=_mm_mul_ps(_mm_set1_ps(a(row,0)),b[0]);
+    r=_mm_add_ps(r,_mm_mul_ps(_mm_set1_ps(a(row,1)),b[1]));
+    r=_mm_add_ps(r,_mm_mul_ps(_mm_set1_ps(a(row,2)),b[2]));
+    return(_mm_add_ps(r,_mm_mul_ps(_mm_set1_ps(a(row,3)),b[3])));
+}
+#endif
+
+#ifdef IK_AVX2_KERNELS
+inline __m256d CIkKernels::_load3(const C3Vector& v)
+{
+    return(_mm256_set_pd(simZero,v(2),v(1),v(0)));
+}
+
+inline C3Vector CIkKernels::_store3(__m256d v)
+{
+    simReal r[4];
+    _mm256_storeu_pd(r,v);
+    return(C3Vector(r[0],r[1],r[2]));
+}
+
+inline __m256d CIkKernels::_cross(__m256d a,__m256d b)
+{ // (a*b.yzx-a.yzx*b).yzx
+    __m256d aYzx=_mm256_permute4x64_pd(a,_MM_SHUFFLE(3,0,2,1));
+    __m256d bYzx=_mm256_permute4x64_pd(b,_MM_SHUFFLE(3,0,2,1));
+    __m256d c=_mm256_sub_pd(_mm256_mul_pd(a,bYzx),_mm256_mul_pd(aYzx,b));
+    return(_mm256_permute4x64_pd(c,_MM_SHUFFLE(3,0,2,1)));
+}
+
+inline __m256d CIkKernels::_dot(__m256d a,__m256d b)
+{ // a.b in all lanes
+    __m256d p=_mm256_mul_pd(a,b);
+    p=_mm256_add_pd(p,_mm256_permute2f128_pd(p,p,0x01));
+    return(_mm256_add_pd(p,_mm256_permute_pd(p,0x05)));
+}
+
+inline __m256d CIkKernels::_rotate(__m256d q,__m256d v,__m256d offset)
+{ // offset+q*v
+    __m256d u=_mm256_and_pd(_mm256_permute4x64_pd(q,_MM_SHUFFLE(0,3,2,1)),_mm256_castsi256_pd(_mm256_set_epi64x(0,-1,-1,-1)));
+    __m256d w=_mm256_permute4x64_pd(q,_MM_SHUFFLE(0,0,0,0));
+    __m256d uv=_dot(u,v);
+    __m256d r=_mm256_mul_pd(_mm256_sub_pd(_mm256_mul_pd(w,w),_dot(u,u)),v);
+    r=_mm256_add_pd(r,_mm256_mul_pd(_mm256_add_pd(uv,uv),u));
+    r=_mm256_add_pd(r,_mm256_mul_pd(_mm256_add_pd(w,w),_cross(u,v)));
+    return(_mm256_add_pd(offset,r));
+}
+
+inline __m256d CIkKernels::_multiplyQuaternions(__m256d a,__m256d b)
+{
+    __m256d p2=_mm256_permute2f128_pd(b,b,0x01);
+    __m256d p1=_mm256_xor_pd(_mm256_permute_pd(b,0x05),_mm256_set_pd(simZero,-simZero,simZero,-simZero));
+    __m256d p3=_mm256_xor_pd(_mm256_permute_pd(p2,0x05),_mm256_set_pd(simZero,simZero,-simZero,-simZero));
+    p2=_mm256_xor_pd(p2,_mm256_set_pd(-simZero,simZero,simZero,-simZero));
+    __m256d r=_mm256_mul_pd(_mm256_permute4x64_pd(a,_MM_SHUFFLE(0,0,0,0)),b);
+    r=_mm256_add_pd(r,_mm256_mul_pd(_mm256_permute4x64_pd(a,_MM_SHUFFLE(1,1,1,1)),p1));
+    r=_mm256_add_pd(r,_mm256_mul_pd(_mm256_permute4x64_pd(a,_MM_SHUFFLE(2,2,2,2)),p2));
+    return(_mm256_add_pd(r,_mm256_mul_pd(_mm256_permute4x64_pd(a,_MM_SHUFFLE(3,3,3,3)),p3)));
+}
+
+inline __m256d CIkKernels::_multiplyRow(const C4X4FullMatrix& a,size_t row,const __m256d* b)
+{
+    __m256d r=_mm256_mul_pd(_mm256_set1_pd(a(row,0)),b[0]);
+    r=_mm256_add_pd(r,_mm256_mul_pd(_mm256_set1_pd(a(row,1)),b[1]));
+    r=_mm256_add_pd(r,_mm256_mul_pd(_mm256_set1_pd(a(row,2)),b[2]));
+    return(_mm256_add_pd(r,_mm256_mul_pd(_mm256_set1_pd(a(row,3)),b[3])));
+}
+#endif
+
+inline void CIkKernels::multiply(const C4X4FullMatrix& a,const C4X4FullMatrix& b,C4X4FullMatrix& result)
+{ // b is entirely loaded, and each row of a is read before the same row of result is written
+#if defined(IK_SSE_KERNELS)
+    __m128 bRows[4]={_mm_loadu_ps(&b(0,0)),_mm_loadu_ps(&b(1,0)),_mm_loadu_ps(&b(2,0)),_mm_loadu_ps(&b(3,0))};
+    for (size_t i=0;i<4;i++)
+        _mm_storeu_ps(&result(i,0),_multiplyRow(a,i,bRows));
+#elif defined(IK_AVX2_KERNELS)
+    __m256d bRows[4]={_mm256_loadu_pd(&b(0,0)),_mm256_loadu_pd(&b(1,0)),_mm256_loadu_pd(&b(2,0)),_mm256_loadu_pd(&b(3,0))};
+    for (size_t i=0;i<4;i++)
+        _mm256_storeu_pd(&result(i,0),_multiplyRow(a,i,bRows));
+#else
+    result=a*b;
+#endif
+}
+
+inline void CIkKernels::addProduct(const C4X4FullMatrix& a,const C4X4FullMatrix& b,C4X4FullMatrix& result)
+{
+#if defined(IK_SSE_KERNELS)
+    __m128 bRows[4]={_mm_loadu_ps(&b(0,0)),_mm_loadu_ps(&b(1,0)),_mm_loadu_ps(&b(2,0)),_mm_loadu_ps(&b(3,0))};
+    for (size_t i=0;i<4;i++)
+        _mm_storeu_ps(&result(i,0),_mm_add_ps(_mm_loadu_ps(&result(i,0)),_multiplyRow(a,i,bRows)));
+#elif defined(IK_AVX2_KERNELS)
+    __m256d bRows[4]={_mm256_loadu_pd(&b(0,0)),_mm256_loadu_pd(&b(1,0)),_mm256_loadu_pd(&b(2,0)),_mm256_loadu_pd(&b(3,0))};
+    for (size_t i=0;i<4;i++)
+        _mm256_storeu_pd(&result(i,0),_mm256_add_pd(_mm256_loadu_pd(&result(i,0)),_multiplyRow(a,i,bRows)));
+#else
+    result+=a*b;
+#endif
+}
+
+inline C4Vector CIkKernels::multiply(const C4Vector& a,const C4Vector& b)
+{
+#if defined(IK_SSE_KERNELS)
+    C4Vector retVal;
+    _mm_storeu_ps(&retVal(0),_multiplyQuaternions(_mm_loadu_ps(&a(0)),_mm_loadu_ps(&b(0))));
+    return(retVal);
+#elif defined(IK_AVX2_KERNELS)
+    C4Vector retVal;
+    _mm256_storeu_pd(&retVal(0),_multiplyQuaternions(_mm256_loadu_pd(&a(0)),_mm256_loadu_pd(&b(0))));
+    return(retVal);
+#else
+    return(a*b);
+#endif
+}
+
+inline C7Vector CIkKernels::multiply(const C7Vector& a,const C7Vector& b)
+{
+#if defined(IK_SSE_KERNELS)
+    C7Vector retVal;
+    __m128 q=_mm_loadu_ps(&a.Q(0));
+    _mm_storeu_ps(&retVal.Q(0),_multiplyQuaternions(q,_mm_loadu_ps(&b.Q(0))));
+    retVal.X=_store3(_rotate(q,_load3(b.X),_load3(a.X)));
+    return(retVal);
+#elif defined(IK_AVX2_KERNELS)
+    C7Vector retVal;
+    __m256d q=_mm256_loadu_pd(&a.Q(0));
+    _mm256_storeu_pd(&retVal.Q(0),_multiplyQuaternions(q,_mm256_loadu_pd(&b.Q(0))));
+    retVal.X=_store3(_rotate(q,_load3(b.X),_load3(a.X)));
+    return(retVal);
+#else
+    return(a*b);
+#endif
+}
+
+inline C7Vector CIkKernels::multiplyInChain(const C7Vector& a,const C7Vector& b)
+{ // When each product is the input of the next one, the AVX2 lane permutes cost more than they save
+#if defined(IK_AVX2_KERNELS)
+    return(a*b);
+#else
+    return(multiply(a,b));
+#endif
+}
+
+inline C7Vector CIkKernels::getInverse(const C7Vector& tr)
+{
+#if defined(IK_SSE_KERNELS)
+    C7Vector retVal;
+    __m128 q=_mm_xor_ps(_mm_loadu_ps(&tr.Q(0)),_mm_set_ps(-simZero,-simZero,-simZero,simZero));
+    _mm_storeu_ps(&retVal.Q(0),q);
+    retVal.X=_store3(_mm_xor_ps(_rotate(q,_load3(tr.X),_mm_setzero_ps()),_mm_set1_ps(-simZero)));
+    return(retVal);
+#elif defined(IK_AVX2_KERNELS)
+    C7Vector retVal;
+    __m256d q=_mm256_xor_pd(_mm256_loadu_pd(&tr.Q(0)),_mm256_set_pd(-simZero,-simZero,-simZero,simZero));
+    _mm256_storeu_pd(&retVal.Q(0),q);
+    retVal.X=_store3(_mm256_xor_pd(_rotate(q,_load3(tr.X),_mm256_setzero_pd()),_mm256_set1_pd(-simZero)));
+    return(retVal);
+#else
+    return(tr.getInverse());
+#endif
+}
+
+inline C3Vector CIkKernels::rotate(const C4Vector& q,const C3Vector& v)
+{
+#if defined(IK_SSE_KERNELS)
+    return(_store3(_rotate(_mm_loadu_ps(&q(0)),_load3(v),_mm_setzero_ps())));
+#elif defined(IK_AVX2_KERNELS)
+    return(_store3(_rotate(_mm256_loadu_pd(&q(0)),_load3(v),_mm256_setzero_pd())));
+#else
+    return(q*v);
+#endif
+}
+
+inline C3Vector CIkKernels::transform(const C7Vector& tr,const C3Vector& v)
+{
+#if defined(IK_SSE_KERNELS)
+    return(_store3(_rotate(_mm_loadu_ps(&tr.Q(0)),_load3(v),_load3(tr.X))));
+#elif defined(IK_AVX2_KERNELS)
+    return(_store3(_rotate(_mm256_loadu_pd(&tr.Q(0)),_load3(v),_load3(tr.X))));
+#else
+    return(tr*v);
+#endif
+}
+
+inline const char* CIkKernels::getImplementation()
+{
+#if defined(IK_SSE_KERNELS)
+    return("sse");
+#elif defined(IK_AVX2_KERNELS)
+    return("avx2");
+#else
+    return("scalar");
+#endif
+}
@@ -0,0 +1,192 @@
+#include "ikModel.h"
+#include "app.h"
+#include "simConst.h"
+
+std::mutex CikModel::_modelsMutex;
+int CikModel::_nextModelHandle=1;
+std::vector<CikModel*> CikModel::_allModels;
+std::vector<int> CikModel::_allModelHandles;
+
+CikModel::CikModel(const App* environment)
+{
+    _snapshot=environment->copyYourself();
+    App* previous=App::currentInstance;
+    App::currentInstance=_snapshot;
+    CObjectContainer* objects=_snapshot->objectContainer;
+    _stateIndices.assign(objects->_objectIndex.size(),-1);
+    size_t stateSize=0;
+    for (size_t i=0;i<objects->jointList.size();i++)
+    {
+        CJoint* joint=objects->getJoint(objects->jointList[i]);
+        _jointHandles.push_back(joint->getObjectHandle());
+        _sphericalJoints.push_back(joint->getJointType()==sim_joint_spherical_subtype);
+        _stateIndices[size_t(joint->getObjectHandle())]=int(stateSize);
+        stateSize+=(_sphericalJoints.back()?4:1);
+    }
+    const std::vector<CikGroup*>& groups=_snapshot->ikGroupContainer->ikGroups;
+    for (size_t i=0;i<groups.size();i++)
+    {
+        _ikGroupResults.push_back(groups[i]->getCalculationResult());
+        for (size_t j=0;j<groups[i]->ikElements.size();j++)
+        {
+            int target=groups[i]->ikElements[j]->getTargetHandle();
+            if ( (objects->getObject(target)!=nullptr)&&(_stateIndices[size_t(target)]==-1) )
+            {
+                _targetHandles.push_back(target);
+                _stateIndices[size_t(target)]=int(stateSize);
+                stateSize+=7;
+            }
+        }
+    }
+    _initialState.resize(stateSize);
+    readState(&_initialState[0]);
+    for (size_t i=0;i<_targetHandles.size();i++)
+    {
+        C7Vector tr(objects->getObject(_targetHandles[i])->getCumulativeTransformationPart1());
+        simReal* s=&_initialState[size_t(_stateIndices[size_t(_targetHandles[i])])];
+        for (size_t j=0;j<4;j++)
+            s[j]=tr.Q(j);
+        for (size_t j=0;j<3;j++)
+            s[4+j]=tr.X(j);
+    }
+    App::currentInstance=previous;
+}
+
+CikModel::~CikModel()
+{ // Objects notify the current environment when erased
+    App* previous=App::currentInstance;
+    for (size_t i=0;i<_freeEnvironments.size();i++)
+    {
+        App::currentInstance=_freeEnvironments[i];
+        delete _freeEnvironments[i];
+    }
+    App::currentInstance=_snapshot;
+    delete _snapshot;
+    App::currentInstance=previous;
+}
+
+size_t CikModel::getStateSize() const
+{
+    return(_initialState.size());
+}
+
+int CikModel::getStateIndex(int objectHandle) const
+{
+    if ( (objectHandle>=0)&&(size_t(objectHandle)<_stateIndices.size()) )
+        return(_stateIndices[size_t(objectHandle)]);
+    return(-1);
+}
+
+void CikModel::getInitialState(simReal* state) const
+{
+    for (size_t i=0;i<_initialState.size();i++)
+        state[i]=_initialState[i];
+}
+
+const simReal* CikModel::getInitialStateData() const
+{
+    return(_initialState.data());
+}
+
+App* CikModel::acquireEnvironment()
+{ // The returned environment is used by the caller only, until releaseEnvironment
+    {
+        std::lock_guard<std::mutex> lock(_environmentsMutex);
+        if (_freeEnvironments.size()!=0)
+        {
+            App* retVal=_freeEnvironments.back();
+            _freeEnvironments.pop_back();
+            return(retVal);
+        }
+    }
+    return(_snapshot->copyYourself()); // copying only reads the snapshot
+}
+
+void CikModel::releaseEnvironment(App* environment)
+{
+    std::lock_guard<std::mutex> lock(_environmentsMutex);
+    _freeEnvironments.push_back(environment);
+}
+
+void CikModel::writeState(const simReal* state) const
+{ // Into the current environment, which is a copy of the snapshot. Joints first, since targets might be attached to them
+    CObjectContainer* objects=App::currentInstance->objectContainer;
+    for (size_t i=0;i<_jointHandles.size();i++)
+    {
+        CJoint* joint=objects->getJoint(_jointHandles[i]);
+        const simReal* s=state+_stateIndices[size_t(_jointHandles[i])];
+        if (_sphericalJoints[i])
+            joint->setSphericalTransformation(C4Vector(s[0],s[1],s[2],s[3]));
+        else
+            joint->setPosition(s[0]);
+    }
+    for (size_t i=0;i<_targetHandles.size();i++)
+    {
+        const simReal* s=state+_stateIndices[size_t(_targetHandles[i])];
+        C7Vector tr;
+        tr.Q=C4Vector(s[0],s[1],s[2],s[3]);
+        tr.X=C3Vector(s[4],s[5],s[6]);
+        objects->setAbsoluteConfiguration(_targetHandles[i],tr,false);
+    }
+    const std::vector<CikGroup*>& groups=App::currentInstance->ikGroupContainer->ikGroups;
+    for (size_t i=0;i<groups.size();i++)
+        groups[i]->setCalculationResult(_ikGroupResults[i]);
+}
+
+void CikModel::readState(simReal* state) const
+{ // Joint values only, from the current environment. Target poses are not modified by solving
+    CObjectContainer* objects=App::currentInstance->objectContainer;
+    for (size_t i=0;i<_jointHandles.size();i++)
+    {
+        CJoint* joint=objects->getJoint(_jointHandles[i]);
+        simReal* s=state+_stateIndices[size_t(_jointHandles[i])];
+        if (_sphericalJoints[i])
+        {
+            C4Vector q(joint->getSphericalTransformation());
+            for (size_t j=0;j<4;j++)
+                s[j]=q(j);
+        }
+        else
+            s[0]=joint->getPosition();
+    }
+}
+
+int CikModel::addModel(CikModel* model)
+{
+    std::lock_guard<std::mutex> lock(_modelsMutex);
+    int handle=_nextModelHandle++;
+    _allModelHandles.push_back(handle);
+    _allModels.push_back(model);
+    return(handle);
+}
+
+CikModel* CikModel::getModel(int handle)
+{
+    std::lock_guard<std::mutex> lock(_modelsMutex);
+    for (size_t i=0;i<_allModelHandles.size();i++)
+    {
+        if (_allModelHandles[i]==handle)
+            return(_allModels[i]);
+    }
+    return(nullptr);
+}
+
+bool CikModel::removeModel(int handle)
+{ // Other threads should not use that model anymore
+    CikModel* model=nullptr;
+    {
+        std::lock_guard<std::mutex> lock(_modelsMutex);
+        for (size_t i=0;i<_allModelHandles.size();i++)
+        {
+            if (_allModelHandles[i]==handle)
+            {
+                model=_allModels[i];
+                _allModelHandles.erase(_allModelHandles.begin()+i);
+                _allModels.erase(_allModels.begin()+i);
+                break;
+            }
+        }
+    }
+    delete model;
+    return(model!=nullptr);
+}
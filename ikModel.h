@@ -0,0 +1,47 @@
+#pragma once
+
+#include "ik.h"
+#include <vector>
+#include <mutex>
+
+class App;
+
+class CikModel
+{ // Read-only snapshot of an environment. What varies from one robot state to the other (the joint values and the
+  // target poses) lives in a caller-owned state buffer, so that many states can share a model. Solves run on
+  // scratch copies of the snapshot, one per concurrent user of the model
+public:
+    CikModel(const App* environment);
+    virtual ~CikModel();
+
+    size_t getStateSize() const;
+    int getStateIndex(int objectHandle) const;
+    void getInitialState(simReal* state) const;
+    const simReal* getInitialStateData() const;
+
+    App* acquireEnvironment();
+    void releaseEnvironment(App* environment);
+    void writeState(const simReal* state) const;
+    void readState(simReal* state) const;
+
+    static int addModel(CikModel* model);
+    static CikModel* getModel(int handle);
+    static bool removeModel(int handle);
+
+private:
+    App* _snapshot;                         // never modified after construction
+    std::vector<int> _jointHandles;         // in jointList order. 1 state value each, or 4 (a quaternion) for spherical joints
+    std::vector<bool> _sphericalJoints;
+    std::vector<int> _targetHandles;        // targets of the IK elements. 7 state values each (absolute pose: quaternion, then position)
+    std::vector<int> _stateIndices;         // by object handle, -1 if the object is not part of the state
+    std::vector<int> _ikGroupResults;       // calculation results of the snapshot, restored with each state
+    std::vector<simReal> _initialState;
+
+    std::mutex _environmentsMutex;
+    std::vector<App*> _freeEnvironments;
+
+    static std::mutex _modelsMutex; // protects the variables below
+    static int _nextModelHandle;
+    static std::vector<CikModel*> _allModels;
+    static std::vector<int> _allModelHandles;
+};
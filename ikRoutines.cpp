@@ -1,9 +1,10 @@
 #include "simConst.h"
 #include "ikRoutines.h"
 #include "app.h"
+#include "ikKernels.h"
 
 
-void CIkRoutines::multiply(const C4X4FullMatrix& d0,const C4X4FullMatrix& dp,size_t index,std::vector<C4X4FullMatrix*>& allMatrices)
+void CIkRoutines::multiply(const C4X4FullMatrix& d0,const C4X4FullMatrix& dp,size_t index,std::vector<C4X4FullMatrix>& allMatrices)
 {
 // Input transformation matrices:
 // Right part:
@@ -15,16 +16,13 @@ void CIkRoutines::multiply(const C4X4FullMatrix& d0,const C4X4FullMatrix& dp,siz
 // index should be between 1 and n (indication which deltaQ dp has to be multiplied with
 // If index is different from that, d0+dp*deltQindex=d0=normal transformation matrix
 // If index==1, it concerns the first joint in the chain (from the tooltip), etc.
-    C4X4FullMatrix& m0=*allMatrices[0];
+    C4X4FullMatrix& m0=allMatrices[0];
     C4X4FullMatrix m0Saved(m0);
-    m0=d0*m0Saved;
+    CIkKernels::multiply(d0,m0Saved,m0);
     for (size_t i=1;i<allMatrices.size();i++)
-        (*allMatrices[i])=d0*(*allMatrices[i]);
+        CIkKernels::multiply(d0,allMatrices[i],allMatrices[i]);
     if ((index>0)&&(index<allMatrices.size()))
-    {
-        C4X4FullMatrix w(dp*m0Saved);
-        (*allMatrices[index])+=w;
-    }
+        CIkKernels::addProduct(dp,m0Saved,allMatrices[index]);
 }
 
 void CIkRoutines::buildDeltaZRotation(C4X4FullMatrix& d0,C4X4FullMatrix& dp,simReal screwCoeff)
@@ -43,68 +41,41 @@ void CIkRoutines::buildDeltaZTranslation(C4X4FullMatrix& d0,C4X4FullMatrix& dp)
     dp(2,3)=simOne;
 }
 
-CMatrix* CIkRoutines::getJacobian(CikElement* ikElement,C4X4Matrix& tooltipTransf,std::vector<int>* rowJointHandles,std::vector<size_t>* rowJointStages)
+bool CIkRoutines::getJacobian(CikElement* ikElement,C4X4Matrix& tooltipTransf,CMatrix*& J,std::vector<C4X4FullMatrix>& jMatrices,std::vector<int>* rowJointHandles,std::vector<size_t>* rowJointStages)
 {   // rowJointHandles is nullptr by default. If not nullptr, it will contain the ids of the joints
     // corresponding to the rows of the jacobian.
-    // Return value nullptr means that is ikElement is either inactive, either invalid
+    // J and jMatrices are caller-owned buffers, reused from one call to the next (only reallocated if the number of DoFs changes)
+    // Return value false means that is ikElement is either inactive, either invalid
     // tooltipTransf is the cumulative transformation matrix of the tooltip,
     // computed relative to the base!
     // The temporary joint parameters need to be initialized before calling this function!
     // We check if the ikElement's base is in the chain and that tooltip is valid!
-    CDummy* tooltip=App::currentInstance->objectContainer->getDummy(ikElement->getTipHandle());
-    if (tooltip==nullptr)
+    const CikChainPlan* plan=ikElement->getChainPlan();
+    if (plan->tip==nullptr)
     { // Should normally never happen!
         ikElement->setIsActive(false);
-        return(nullptr);
+        return(false);
     }
-    CSceneObject* base=App::currentInstance->objectContainer->getObject(ikElement->getBaseHandle());
-    if ( (base!=nullptr)&&(!tooltip->isObjectAffiliatedWith(base)) )
+    if (!plan->baseOk)
     { // This case can happen (when the base's parenting was changed for instance)
         ikElement->setBaseHandle(-1);
         ikElement->setIsActive(false);
-        return(nullptr);
-    }
-
-    // We check the number of degrees of freedom and prepare the rowJointHandles vector:
-    CSceneObject* iterat=tooltip;
-    size_t doF=0;
-    while (iterat!=base)
-    {
-        iterat=iterat->getParentObject();
-        if ( (iterat!=nullptr)&&(iterat!=base) )
-        {
-            if (iterat->getObjectType()==sim_object_joint_type)
-            {
-                if ( ((static_cast<CJoint*>(iterat))->getJointMode()==sim_jointmode_ik)||((static_cast<CJoint*>(iterat))->getJointMode()==sim_jointmode_reserved_previously_ikdependent)||((static_cast<CJoint*>(iterat))->getJointMode()==sim_jointmode_dependent) )
-                {
-                    size_t d=(static_cast<CJoint*>(iterat))->getDoFs();
-                    for (int i=int(d-1);i>=0;i--)
-                    {
-                        if (rowJointHandles!=nullptr)
-                        {
-                            rowJointHandles->push_back(iterat->getObjectHandle());
-                            rowJointStages->push_back(size_t(i));
-                        }
-                    }
-                    doF+=d;
-                }
-            }
-        }
+        return(false);
     }
-    CMatrix* J=new CMatrix(6,doF);
-    std::vector<C4X4FullMatrix*> jMatrices;
-    for (size_t i=0;i<doF+1;i++)
+    CSceneObject* base=plan->base;
+    size_t doF=plan->doF;
+    if (rowJointHandles!=nullptr)
     {
-        C4X4FullMatrix* matr=new C4X4FullMatrix();
-        if (i==0)
-            (*matr).setIdentity();
-        else
-            (*matr).clear();
-        jMatrices.push_back(matr);
+        rowJointHandles->assign(plan->rowJointHandles.begin(),plan->rowJointHandles.end());
+        rowJointStages->assign(plan->rowJointStages.begin(),plan->rowJointStages.end());
     }
+    reserveMatrix(J,6,doF);
+    jMatrices.resize(doF+1);
+    jMatrices[0].setIdentity();
+    for (size_t i=1;i<doF+1;i++)
+        jMatrices[i].clear();
 
     // Now we go from tip to base:
-    iterat=tooltip;
     C4X4FullMatrix buff;
     buff.setIdentity();
     size_t positionCounter=0;
@@ -112,44 +83,25 @@ CMatrix* CIkRoutines::getJacobian(CikElement* ikElement,C4X4Matrix& tooltipTrans
     C4X4FullMatrix dp;
     C4X4FullMatrix paramPart;
     CJoint* lastJoint=nullptr;
-    int indexCnt=-1;
-    int indexCntLast=-1;
-    while (iterat!=base)
+    size_t lastStage=0;
+    size_t stepCnt=plan->stepObjects.size();
+    for (size_t step=0;step<stepCnt;step++)
     {
-        CSceneObject* nextIterat=iterat->getParentObject();
+        CJoint* joint=plan->stepJoints[step];
         C7Vector local;
-        if (iterat->getObjectType()==sim_object_joint_type)
+        if (joint==nullptr)
+            local=plan->stepObjects[step]->getLocalTransformation(true);
+        else
         {
-            if ( ((static_cast<CJoint*>(iterat))->getJointMode()!=sim_jointmode_ik)&&((static_cast<CJoint*>(iterat))->getJointMode()!=sim_jointmode_reserved_previously_ikdependent)&&((static_cast<CJoint*>(iterat))->getJointMode()!=sim_jointmode_dependent) )
-                local=iterat->getLocalTransformation(true);
+            if (joint->getJointType()==sim_joint_spherical_subtype)
+                joint->getLocalTransformationExPart1(local,plan->stepStages[step]);
             else
-            {
-                CJoint* it=static_cast<CJoint*>(iterat);
-                if (it->getJointType()==sim_joint_spherical_subtype)
-                {
-                    if (indexCnt==-1)
-                        indexCnt=int(it->getDoFs())-1;
-                    it->getLocalTransformationExPart1(local,size_t(indexCnt--));
-                    if (indexCnt!=-1)
-                        nextIterat=iterat; // We keep the same object! (but indexCnt has decreased)
-                }
-                else
-                    local=iterat->getLocalTransformationPart1(true);
-            }
+                local=joint->getLocalTransformationPart1(true);
         }
-        else
-            local=iterat->getLocalTransformation(true); 
 
-        buff=C4X4FullMatrix(local.getMatrix())*buff;
-        iterat=nextIterat;
-        bool activeJoint=false;
-        if (iterat!=nullptr) // Following lines recently changed!
-        {
-            if (iterat->getObjectType()==sim_object_joint_type) 
-                activeJoint=( ((static_cast<CJoint*>(iterat))->getJointMode()==sim_jointmode_ik)||((static_cast<CJoint*>(iterat))->getJointMode()==sim_jointmode_reserved_previously_ikdependent)||((static_cast<CJoint*>(iterat))->getJointMode()==sim_jointmode_dependent) );
-        }
-        if ( (iterat==base)||activeJoint )
-        {   // If base is nullptr then the second part is not evaluated (iterat->getObjectType())
+        CIkKernels::multiply(C4X4FullMatrix(local.getMatrix()),buff,buff);
+        if ( (step+1==stepCnt)||(plan->stepJoints[step+1]!=nullptr) )
+        {   // We reached the base or an IK joint
             if (positionCounter==0)
             {   // Here we have the first part (from tooltip to first joint)
                 d0=buff;
@@ -174,16 +126,18 @@ CMatrix* CIkRoutines::getJacobian(CikElement* ikElement,C4X4Matrix& tooltipTrans
                 { // Spherical joint part!
                     buildDeltaZRotation(d0,dp,0.0);
                     multiply(d0,dp,positionCounter,jMatrices);
-                    if (indexCntLast==-1)
-                        indexCntLast=int(lastJoint->getDoFs())-1;
-                    paramPart.buildZRotation(lastJoint->getTempParameterEx(size_t(indexCntLast--)));
+                    paramPart.buildZRotation(lastJoint->getTempParameterEx(lastStage));
                 }
-                d0=buff*paramPart;
+                CIkKernels::multiply(buff,paramPart,d0);
                 dp.clear();
                 multiply(d0,dp,0,jMatrices);
             }
             buff.setIdentity();
-            lastJoint=static_cast<CJoint*>(iterat);
+            if (step+1<stepCnt)
+            {
+                lastJoint=plan->stepJoints[step+1];
+                lastStage=plan->stepStages[step+1];
+            }
             positionCounter++;
         }
     }
@@ -199,7 +153,7 @@ CMatrix* CIkRoutines::getJacobian(CikElement* ikElement,C4X4Matrix& tooltipTrans
             currentBase.setIdentity();
             if (base!=nullptr)
                 currentBase=base->getCumulativeTransformation(true); // could be a joint, we want also the joint intrinsic transformation part!
-            C4X4FullMatrix correction((alternativeBase.getInverse()*currentBase).getMatrix());
+            C4X4FullMatrix correction(CIkKernels::multiply(CIkKernels::getInverse(alternativeBase),currentBase).getMatrix());
             dp.clear();
             multiply(correction,dp,0,jMatrices);
         }
@@ -208,37 +162,201 @@ CMatrix* CIkRoutines::getJacobian(CikElement* ikElement,C4X4Matrix& tooltipTrans
     // The x-, y- and z-component:
     for (size_t i=0;i<doF;i++)
     {
-        (*J)(0,i)=(*jMatrices[1+i])(0,3);
-        (*J)(1,i)=(*jMatrices[1+i])(1,3);
-        (*J)(2,i)=(*jMatrices[1+i])(2,3);
+        (*J)(0,i)=jMatrices[1+i](0,3);
+        (*J)(1,i)=jMatrices[1+i](1,3);
+        (*J)(2,i)=jMatrices[1+i](2,3);
     }
     // We divide all delta components (to avoid distorsions)...
     for (size_t i=0;i<doF;i++)
-        (*jMatrices[1+i])/=IK_DIVISION_FACTOR;
+        jMatrices[1+i]/=IK_DIVISION_FACTOR;
     // ...and add the cumulative transform to the delta-components:
     for (size_t i=0;i<doF;i++)
-        (*jMatrices[1+i])+=(*jMatrices[0]);
+        jMatrices[1+i]+=jMatrices[0];
     // We also copy the cumulative transform to 'tooltipTransf':
-    tooltipTransf=(*jMatrices[0]);
+    tooltipTransf=jMatrices[0];
     // Now we extract the delta Euler components:
-    C4X4FullMatrix mainInverse(*jMatrices[0]);
+    C4X4FullMatrix mainInverse(jMatrices[0]);
     mainInverse.invert();
     C4X4FullMatrix tmp;
     // Alpha-, Beta- and Gamma-components:
     for (size_t i=0;i<doF;i++)
     {
-        tmp=mainInverse*(*jMatrices[1+i]);
+        tmp=mainInverse*jMatrices[1+i];
         C3Vector euler(tmp.getEulerAngles());
         (*J)(3,i)=euler(0); // here we would have to multiply the euler angle with IK_DIVISION_FACTOR to get the "correct" Jacobian
         (*J)(4,i)=euler(1); // here we would have to multiply the euler angle with IK_DIVISION_FACTOR to get the "correct" Jacobian
         (*J)(5,i)=euler(2); // here we would have to multiply the euler angle with IK_DIVISION_FACTOR to get the "correct" Jacobian
     }
-
-    // We free the memory allocated for each joint variable:
-    for (size_t i=0;i<jMatrices.size();i++)
-        delete jMatrices[i];
-    return(J);
+    return(true);
 }
 
+bool CIkRoutines::getGeometricJacobian(CikElement* ikElement,C4X4Matrix& tooltipTransf,CMatrix*& J,std::vector<int>* rowJointHandles,std::vector<size_t>* rowJointStages)
+{   // Same output as getJacobian (the angular rows are also divided by IK_DIVISION_FACTOR), but each column
+    // is directly built from the joint axis and the tip position, in a single tip-to-base pass:
+    // O(n) instead of O(n^2) matrix products, and no Euler angle finite differences.
+    // Columns are first expressed in the tip frame, then the linear part is rotated into the base frame at the end.
+    const CikChainPlan* plan=ikElement->getChainPlan();
+    if (plan->tip==nullptr)
+    { // Should normally never happen!
+        ikElement->setIsActive(false);
+        return(false);
+    }
+    if (!plan->baseOk)
+    { // This case can happen (when the base's parenting was changed for instance)
+        ikElement->setBaseHandle(-1);
+        ikElement->setIsActive(false);
+        return(false);
+    }
+    CSceneObject* base=plan->base;
+    size_t doF=plan->doF;
+    if (rowJointHandles!=nullptr)
+    {
+        rowJointHandles->assign(plan->rowJointHandles.begin(),plan->rowJointHandles.end());
+        rowJointStages->assign(plan->rowJointStages.begin(),plan->rowJointStages.end());
+    }
+    reserveMatrix(J,6,doF);
 
+    // Now we go from tip to base. tipTr is the tip pose relative to the frame reached so far:
+    C7Vector buff;
+    buff.setIdentity();
+    C7Vector tipTr;
+    tipTr.setIdentity();
+    C7Vector paramPart;
+    size_t positionCounter=0;
+    CJoint* lastJoint=nullptr;
+    size_t lastStage=0;
+    size_t lastColumn=0;
+    size_t stepCnt=plan->stepObjects.size();
+    for (size_t step=0;step<stepCnt;step++)
+    {
+        CJoint* joint=plan->stepJoints[step];
+        C7Vector local;
+        if (joint==nullptr)
+            local=plan->stepObjects[step]->getLocalTransformation(true);
+        else
+        {
+            if (joint->getJointType()==sim_joint_spherical_subtype)
+                joint->getLocalTransformationExPart1(local,plan->stepStages[step]);
+            else
+                local=joint->getLocalTransformationPart1(true);
+        }
 
+        buff=CIkKernels::multiply(local,buff);
+        if ( (step+1==stepCnt)||(plan->stepJoints[step+1]!=nullptr) )
+        {   // We reached the base or an IK joint
+            if (positionCounter==0)
+                tipTr=buff; // Here we have the first part (from tooltip to first joint)
+            else
+            {   // Here we have a joint. Its axis is the z-axis of the frame tipTr is expressed in:
+                C4Vector tipRotInv(tipTr.Q.getInverse());
+                C3Vector linear(simZero,simZero,simZero);
+                C3Vector angular(simZero,simZero,simZero);
+                paramPart.setIdentity();
+                if (lastJoint->getJointType()==sim_joint_revolute_subtype)
+                {
+                    linear=C3Vector(-tipTr.X(1),tipTr.X(0),lastJoint->getScrewPitch());
+                    angular=C3Vector::unitZVector;
+                    paramPart.Q.setAngleAndAxis(lastJoint->getPosition(true),C3Vector::unitZVector);
+                }
+                else if (lastJoint->getJointType()==sim_joint_prismatic_subtype)
+                {
+                    linear=C3Vector::unitZVector;
+                    paramPart.X(2)=lastJoint->getPosition(true);
+                }
+                else
+                { // Spherical joint part!
+                    linear=C3Vector(-tipTr.X(1),tipTr.X(0),simZero);
+                    angular=C3Vector::unitZVector;
+                    paramPart.Q.setAngleAndAxis(lastJoint->getTempParameterEx(lastStage),C3Vector::unitZVector);
+                }
+                linear=CIkKernels::rotate(tipRotInv,linear);
+                angular=CIkKernels::rotate(tipRotInv,angular);
+                for (size_t i=0;i<3;i++)
+                {
+                    (*J)(i,lastColumn)=linear(i);
+                    (*J)(3+i,lastColumn)=angular(i)/IK_DIVISION_FACTOR;
+                }
+                tipTr=CIkKernels::multiply(CIkKernels::multiply(buff,paramPart),tipTr);
+            }
+            buff.setIdentity();
+            if (step+1<stepCnt)
+            {
+                lastJoint=plan->stepJoints[step+1];
+                lastStage=plan->stepStages[step+1];
+                lastColumn=plan->stepColumns[step+1];
+            }
+            positionCounter++;
+        }
+    }
+
+    int alternativeBaseForConstraints=ikElement->getAltBaseHandleForConstraints();
+    if (alternativeBaseForConstraints!=-1)
+    {
+        CDummy* alb=App::currentInstance->objectContainer->getDummy(alternativeBaseForConstraints);
+        if (alb!=nullptr)
+        { // We want everything relative to the alternativeBaseForConstraints dummy orientation!
+            C7Vector alternativeBase(alb->getCumulativeTransformationPart1(true));
+            C7Vector currentBase;
+            currentBase.setIdentity();
+            if (base!=nullptr)
+                currentBase=base->getCumulativeTransformation(true); // could be a joint, we want also the joint intrinsic transformation part!
+            tipTr=CIkKernels::multiply(CIkKernels::multiply(CIkKernels::getInverse(alternativeBase),currentBase),tipTr);
+        }
+    }
+
+    // The linear parts are rotated from the tip frame into the base frame (the angular parts stay in the tip frame):
+    for (size_t i=0;i<doF;i++)
+    {
+        C3Vector linear(CIkKernels::rotate(tipTr.Q,C3Vector((*J)(0,i),(*J)(1,i),(*J)(2,i))));
+        (*J)(0,i)=linear(0);
+        (*J)(1,i)=linear(1);
+        (*J)(2,i)=linear(2);
+    }
+    tooltipTransf=tipTr.getMatrix();
+    return(true);
+}
+
+void CIkRoutines::reserveMatrix(CMatrix*& m,size_t rows,size_t cols)
+{ // Reallocates m only if its shape changed. Content is undefined afterwards
+    if ( (m==nullptr)||(m->rows!=rows)||(m->cols!=cols) )
+    {
+        delete m;
+        m=new CMatrix(rows,cols);
+    }
+}
+
+bool CIkRoutines::solveSymmetricSystem(simReal* m,size_t n,simReal* rhs)
+{   // Solves m*x=rhs in place (x is returned in rhs), where m is a row-major, symmetric positive (semi-)definite n x n matrix
+    // m is overwritten by its LDLT factorization (L in the strict lower triangle, D on the diagonal)
+    // Returns false if m is not positive definite, i.e. where inverting m would have failed
+    for (size_t j=0;j<n;j++)
+    {
+        simReal d=m[j*n+j];
+        for (size_t k=0;k<j;k++)
+            d-=m[j*n+k]*m[j*n+k]*m[k*n+k];
+        if (d<=simZero)
+            return(false);
+        m[j*n+j]=d;
+        for (size_t i=j+1;i<n;i++)
+        {
+            simReal v=m[i*n+j];
+            for (size_t k=0;k<j;k++)
+                v-=m[i*n+k]*m[j*n+k]*m[k*n+k];
+            m[i*n+j]=v/d;
+        }
+    }
+    // Forward substitution (L), diagonal (D), then back substitution (LT):
+    for (size_t i=0;i<n;i++)
+    {
+        for (size_t k=0;k<i;k++)
+            rhs[i]-=m[i*n+k]*rhs[k];
+    }
+    for (size_t i=0;i<n;i++)
+        rhs[i]/=m[i*n+i];
+    for (size_t i=n;i>0;i--)
+    {
+        for (size_t k=i;k<n;k++)
+            rhs[i-1]-=m[k*n+i-1]*rhs[k];
+    }
+    return(true);
+}
@@ -10,9 +10,12 @@
 class CIkRoutines  
 {
 public:
-    static void multiply(const C4X4FullMatrix& d0,const C4X4FullMatrix& dp,size_t index,std::vector<C4X4FullMatrix*>& allMatrices);
+    static void multiply(const C4X4FullMatrix& d0,const C4X4FullMatrix& dp,size_t index,std::vector<C4X4FullMatrix>& allMatrices);
     static void buildDeltaZRotation(C4X4FullMatrix& d0,C4X4FullMatrix& dp,simReal screwCoeff);
     static void buildDeltaZTranslation(C4X4FullMatrix& d0,C4X4FullMatrix& dp);
-    static CMatrix* getJacobian(CikElement* ikElement,C4X4Matrix& tooltipTransf,std::vector<int>* rowJointHandles=nullptr,std::vector<size_t>* rowJointStages=nullptr);
+    static bool getJacobian(CikElement* ikElement,C4X4Matrix& tooltipTransf,CMatrix*& J,std::vector<C4X4FullMatrix>& jMatrices,std::vector<int>* rowJointHandles=nullptr,std::vector<size_t>* rowJointStages=nullptr);
+    static bool getGeometricJacobian(CikElement* ikElement,C4X4Matrix& tooltipTransf,CMatrix*& J,std::vector<int>* rowJointHandles=nullptr,std::vector<size_t>* rowJointStages=nullptr);
+    static void reserveMatrix(CMatrix*& m,size_t rows,size_t cols);
+    static bool solveSymmetricSystem(simReal* m,size_t n,simReal* rhs);
     static void performGroupIK(CikGroup* ikGroup);
 };
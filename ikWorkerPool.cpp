@@ -0,0 +1,100 @@
+#include "ikWorkerPool.h"
+#include "app.h"
+
+CIkWorkerPool::CIkWorkerPool()
+{
+    _busyThreads=0;
+    _runWorkerCnt=0;
+    _run=0;
+    _environment=nullptr;
+    _environmentHandle=0;
+    _environmentRevision=0;
+    _workFunction=nullptr;
+    _workData=nullptr;
+    _quit=false;
+}
+
+CIkWorkerPool::~CIkWorkerPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _quit=true;
+    }
+    _runCondition.notify_all();
+    for (size_t i=0;i<_threads.size();i++)
+        _threads[i].join();
+    App* current=App::currentInstance;
+    for (size_t i=0;i<_environments.size();i++)
+    { // erasing objects and groups refers to the current environment
+        App::currentInstance=_environments[i];
+        delete _environments[i];
+    }
+    App::currentInstance=current;
+}
+
+void CIkWorkerPool::run(size_t workerCnt,WorkFunction work,void* data)
+{
+    while (_threads.size()+1<workerCnt)
+        _threads.push_back(std::thread(&CIkWorkerPool::_workerThread,this,_threads.size()+1,_run));
+    while (_environments.size()<workerCnt)
+    {
+        _environments.push_back(nullptr);
+        _environmentRevisions.push_back(0);
+    }
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _environment=App::currentInstance;
+        _environmentHandle=App::currentInstanceHandle;
+        _environmentRevision=App::currentInstance->getRevision();
+        _workFunction=work;
+        _workData=data;
+        _runWorkerCnt=workerCnt;
+        _busyThreads=workerCnt-1;
+        _run++;
+    }
+    _runCondition.notify_all();
+    App* environment=App::currentInstance;
+    _work(0);
+    App::currentInstance=environment;
+    std::unique_lock<std::mutex> lock(_mutex);
+    while (_busyThreads>0)
+        _doneCondition.wait(lock);
+}
+
+void CIkWorkerPool::_workerThread(size_t workerIndex,unsigned long long lastRun)
+{ // Pool thread. Sleeps between runs, and skips the runs that use fewer workers
+    std::unique_lock<std::mutex> lock(_mutex);
+    while (true)
+    {
+        while ( (!_quit)&&(_run==lastRun) )
+            _runCondition.wait(lock);
+        if (_quit)
+            break;
+        lastRun=_run;
+        if (workerIndex<_runWorkerCnt)
+        {
+            lock.unlock();
+            _work(workerIndex);
+            App::currentInstance=nullptr;
+            App::currentInstanceHandle=0;
+            lock.lock();
+            _busyThreads--;
+            if (_busyThreads==0)
+                _doneCondition.notify_all();
+        }
+    }
+}
+
+void CIkWorkerPool::_work(size_t workerIndex)
+{ // Copies the environment again if it changed since the last run. Copying only reads the environment
+    if ( (_environments[workerIndex]==nullptr)||(_environmentRevisions[workerIndex]!=_environmentRevision) )
+    {
+        App::currentInstance=_environments[workerIndex]; // erasing objects and groups refers to the current environment
+        delete _environments[workerIndex];
+        _environments[workerIndex]=_environment->copyYourself();
+        _environmentRevisions[workerIndex]=_environmentRevision;
+    }
+    App::currentInstance=_environments[workerIndex];
+    App::currentInstanceHandle=_environmentHandle;
+    _workFunction(_workData,workerIndex,_runWorkerCnt);
+}
@@ -0,0 +1,45 @@
+#pragma once
+
+#include "ik.h"
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+class App;
+
+class CIkWorkerPool
+{ // Persistent threads that spread work over several workers, each working in its own copy of the environment. The copies
+  // are kept from one run to the next, and are only made again once the environment changed (see App::getRevision)
+public:
+    CIkWorkerPool();
+    virtual ~CIkWorkerPool();
+
+    typedef void (*WorkFunction)(void* data,size_t workerIndex,size_t workerCnt);
+
+    // Calls work on workerCnt workers, in copies of the current environment. The calling thread is worker 0. Returns once
+    // all workers are done. A worker may modify its copy, as long as it restores it before returning:
+    void run(size_t workerCnt,WorkFunction work,void* data);
+
+private:
+    void _workerThread(size_t workerIndex,unsigned long long lastRun);
+    void _work(size_t workerIndex);
+
+    std::vector<App*> _environments; // copy of each worker
+    std::vector<unsigned long long> _environmentRevisions; // revision of the environment when copied
+
+    // Current run. Protected by _mutex:
+    std::mutex _mutex;
+    std::condition_variable _runCondition; // pool threads wait for a run
+    std::condition_variable _doneCondition; // the caller waits for the end of the run
+    size_t _busyThreads; // pool threads not yet done with the current run
+    size_t _runWorkerCnt; // caller included
+    unsigned long long _run;
+    const App* _environment;
+    int _environmentHandle;
+    unsigned long long _environmentRevision;
+    WorkFunction _workFunction;
+    void* _workData;
+    bool _quit;
+    std::vector<std::thread> _threads; // worker i is _threads[i-1]. The caller is worker 0
+};
@@ -0,0 +1,26 @@
+#include "ikWorkspace.h"
+
+CikWorkspace::CikWorkspace()
+{
+    rows=0;
+    doF=0;
+    columnMapVersion=0;
+    footprintVersion=0;
+}
+
+CikWorkspace::~CikWorkspace()
+{
+}
+
+void CikWorkspace::prepareMainSystem(size_t theRows,size_t theDoF)
+{ // std::vector::assign/resize never shrink the capacity, so this only allocates when the system grows:
+    rows=theRows;
+    doF=theDoF;
+    mainMatrix.assign(rows*doF,simZero);
+    mainMatrix_correctJacobian.assign(rows*doF,simZero);
+    mainErrorVector.assign(rows,simZero);
+    jjt.resize(rows*rows);
+    jjtRhs.resize(rows);
+    weightCoeffs.resize(doF);
+    solution.assign(doF,simZero);
+}
@@ -0,0 +1,53 @@
+#pragma once
+
+#include "ik.h"
+#include <vector>
+
+class CJoint;
+class CikElement;
+
+class CikWorkspace
+{
+public:
+    CikWorkspace();
+    virtual ~CikWorkspace();
+
+    void prepareMainSystem(size_t rows,size_t doF);
+
+    // Buffers are row-major and only grow, i.e. once warmed-up, a pass does not touch the heap anymore:
+    std::vector<CikElement*> validElements;
+
+    // Joint footprint. Valid for footprintVersion (the topology version) and as long as the elements and their
+    // tip/target/base handles did not change:
+    std::vector<CJoint*> readJoints;                // joints reset and applied by the group, see CikGroup::getReadJoints
+    std::vector<CJoint*> touchedJoints;             // readJoints and the joints that depend on them, i.e. that are rectified
+    std::vector<int> footprintHandles;              // tip, target, base and alt. base handle of each element
+    unsigned int footprintVersion;
+
+    // Column map, i.e. the global column of each element column. Valid for columnMapVersion (the topology version)
+    // and as long as the valid elements and their chain plans did not change:
+    std::vector<CJoint*> allJoints;                 // joint of each global column
+    std::vector<size_t> allJointStages;             // joint stage of each global column
+    std::vector<size_t> elementColumnOffsets;       // offset of each valid element into elementColumns
+    std::vector<size_t> elementColumns;             // global column of each element column
+    std::vector<size_t> dependentColumns;           // non-spherical columns in dependent mode (one joint constraint equation each)
+    std::vector<int> dependentMasterColumns;        // column of the joint they depend on, -1 if not in the group
+    std::vector<CikElement*> columnMapElements;
+    std::vector<unsigned int> columnMapPlanBuilds;
+    unsigned int columnMapVersion;
+
+    std::vector<simReal> limitationError;
+    std::vector<size_t> limitationIndex;
+    std::vector<simReal> limitationValue;
+
+    std::vector<simReal> mainMatrix;                // rows x doF
+    std::vector<simReal> mainMatrix_correctJacobian;// rows x doF
+    std::vector<simReal> mainErrorVector;           // rows
+    std::vector<simReal> jjt;                       // rows x rows
+    std::vector<simReal> jjtRhs;                    // rows
+    std::vector<simReal> weightCoeffs;              // doF, signed square roots of the joint weights
+    std::vector<simReal> solution;                  // doF
+
+    size_t rows;
+    size_t doF;
+};
@@ -50,16 +50,32 @@ void CJoint::performSceneObjectLoadingMapping(const std::vector<int>* map)
     _dependencyJointHandle=_getLoadingMapping(map,_dependencyJointHandle);
 }
 
+CSceneObject* CJoint::copyYourself() const
+{
+    return(new CJoint(*this));
+}
+
+void CJoint::performObjectCopyMapping(const std::vector<CSceneObject*>& objectIndex)
+{
+    performObjectCopyMappingMain(objectIndex);
+    for (size_t i=0;i<dependentJoints.size();i++)
+        dependentJoints[i]=static_cast<CJoint*>(objectIndex[size_t(dependentJoints[i]->getObjectHandle())]);
+}
+
 void CJoint::setJointMode(int theMode)
 {
+    CObjectContainer* container=App::currentInstance->objectContainer;
+    bool inContainer=(container->getObject(getObjectHandle())==this);
+    CJoint* previousMaster=nullptr;
+    if (inContainer)
+        previousMaster=container->getDependencyMaster(this);
+    if (theMode!=_jointMode)
+        container->incrementTopologyVersion(false);
     _jointMode=theMode;
     if ( (theMode!=sim_jointmode_dependent)&&(theMode!=sim_jointmode_reserved_previously_ikdependent) )
-    {
-        bool d=(_dependencyJointHandle!=-1);
         _dependencyJointHandle=-1;
-        if (d)
-            App::currentInstance->objectContainer->actualizeObjectInformation();
-    }
+    if (inContainer)
+        container->announceJointDependencyChanged(this,previousMaster);
     setPosition(getPosition());
     setSphericalTransformation(getSphericalTransformation());
 }
@@ -98,7 +114,14 @@ bool CJoint::setDependencyJointHandle(int jointHandle)
     bool retVal=false;
     if ( (_jointType!=sim_joint_spherical_subtype)&&(getJointMode()==sim_jointmode_dependent) )
     {
+        CObjectContainer* container=App::currentInstance->objectContainer;
+        bool inContainer=(container->getObject(getObjectHandle())==this);
+        CJoint* previousMaster=nullptr;
+        if (inContainer)
+            previousMaster=container->getDependencyMaster(this);
         _dependencyJointHandle=jointHandle;
+        if (inContainer)
+            container->announceJointDependencyChanged(this,previousMaster);
         if (jointHandle!=-1)
         {
             // Illegal loop check:
@@ -116,14 +139,8 @@ bool CJoint::setDependencyJointHandle(int jointHandle)
                 }
                 iterat=App::currentInstance->objectContainer->getJoint(joint);
             }
-            App::currentInstance->objectContainer->actualizeObjectInformation();
             setPosition(getPosition());
         }
-        else
-        {
-            _dependencyJointHandle=-1;
-            App::currentInstance->objectContainer->actualizeObjectInformation();
-        }
         retVal=true;
     }
     return(retVal);
@@ -166,7 +183,11 @@ void CJoint::setScrewPitch(simReal p)
     if (_jointType==sim_joint_revolute_subtype)
     {
         if (_jointMode!=sim_jointmode_force)
+        {
             _screwPitch=p;
+            _invalidateCumulativeTransformation(false);
+            _invalidateCumulativeTransformation(true);
+        }
     }
 }
 
@@ -186,6 +207,8 @@ void CJoint::setSphericalTransformation(const C4Vector& tr)
         }
     }
     _sphericalTransformation=transf;
+    _invalidateCumulativeTransformation(false);
+    _invalidateCumulativeTransformation(true); // the temp. transformation is relative to the real one
 }
 
 C4Vector CJoint::getSphericalTransformation() const
@@ -235,6 +258,7 @@ void CJoint::setPosition(simReal parameter,bool tempVals)
         _jointPosition_tempForIK=parameter;
     else
         _jointPosition=parameter;
+    _invalidateCumulativeTransformation(tempVals);
 
     if (_jointMode==sim_jointmode_dependent)
     {
@@ -293,6 +317,8 @@ void CJoint::setPositionIsCyclic(bool c)
         if (getJointType()==sim_joint_revolute_subtype)
         {
             _screwPitch=simZero;
+            _invalidateCumulativeTransformation(false);
+            _invalidateCumulativeTransformation(true);
             _jointMinPosition=-piValue;
             _jointPositionRange=piValTimes2;
             _positionIsCyclic=c;
@@ -302,6 +328,7 @@ void CJoint::setPositionIsCyclic(bool c)
 
 void CJoint::initializeParametersForIK(simReal angularJointLimitationThreshold)
 {
+    _invalidateCumulativeTransformation(true);
     if (_jointType!=sim_joint_spherical_subtype)
         _jointPosition_tempForIK=_jointPosition;
     else
@@ -409,6 +436,7 @@ simReal CJoint::getTempParameterEx(size_t index) const
 
 void CJoint::setTempParameterEx(simReal parameter,size_t index)
 {
+    _invalidateCumulativeTransformation(true);
     if (index==0)
         _sphericalTransformation_euler1TempForIK=parameter;
     if (index==1)
@@ -500,20 +528,63 @@ void CJoint::serialize(CSerialization& ar)
 {
     serializeMain(ar);
     _jointType=ar.readInt();
-    _screwPitch=simReal(ar.readFloat());
-    _sphericalTransformation(0)=simReal(ar.readFloat());
-    _sphericalTransformation(1)=simReal(ar.readFloat());
-    _sphericalTransformation(2)=simReal(ar.readFloat());
-    _sphericalTransformation(3)=simReal(ar.readFloat());
+    float v[5];
+    ar.readFloats(v,5);
+    _screwPitch=simReal(v[0]);
+    _sphericalTransformation(0)=simReal(v[1]);
+    _sphericalTransformation(1)=simReal(v[2]);
+    _sphericalTransformation(2)=simReal(v[3]);
+    _sphericalTransformation(3)=simReal(v[4]);
     unsigned char dummy=ar.readByte();
     _positionIsCyclic=SIM_IS_BIT_SET(dummy,0);
-    _jointMinPosition=simReal(ar.readFloat());
-    _jointPositionRange=simReal(ar.readFloat());
-    _jointPosition=simReal(ar.readFloat());
-    _maxStepSize=simReal(ar.readFloat());
-    _ikWeight=simReal(ar.readFloat());
+    ar.readFloats(v,5);
+    _jointMinPosition=simReal(v[0]);
+    _jointPositionRange=simReal(v[1]);
+    _jointPosition=simReal(v[2]);
+    _maxStepSize=simReal(v[3]);
+    _ikWeight=simReal(v[4]);
     _jointMode=ar.readInt();
     _dependencyJointHandle=ar.readInt();
     _dependencyJointMult=simReal(ar.readFloat());
     _dependencyJointAdd=simReal(ar.readFloat());
 }
+
+void CJoint::writeRecord(SIkObjectRecord& rec) const
+{
+    writeRecordMain(rec);
+    rec.ints[IK_OBJECT_JOINT_TYPE]=_jointType;
+    rec.ints[IK_OBJECT_JOINT_FLAGS]=0;
+    if (_positionIsCyclic)
+        rec.ints[IK_OBJECT_JOINT_FLAGS]|=1;
+    rec.ints[IK_OBJECT_JOINT_MODE]=_jointMode;
+    rec.ints[IK_OBJECT_JOINT_DEPENDENCY_HANDLE]=_dependencyJointHandle;
+    rec.reals[IK_OBJECT_JOINT_SCREW_PITCH]=_screwPitch;
+    for (size_t i=0;i<4;i++)
+        rec.reals[IK_OBJECT_JOINT_SPHERICAL_QUATERNION+i]=_sphericalTransformation(i);
+    rec.reals[IK_OBJECT_JOINT_MIN_POSITION]=_jointMinPosition;
+    rec.reals[IK_OBJECT_JOINT_POSITION_RANGE]=_jointPositionRange;
+    rec.reals[IK_OBJECT_JOINT_POSITION]=_jointPosition;
+    rec.reals[IK_OBJECT_JOINT_MAX_STEP_SIZE]=_maxStepSize;
+    rec.reals[IK_OBJECT_JOINT_IK_WEIGHT]=_ikWeight;
+    rec.reals[IK_OBJECT_JOINT_DEPENDENCY_MULT]=_dependencyJointMult;
+    rec.reals[IK_OBJECT_JOINT_DEPENDENCY_ADD]=_dependencyJointAdd;
+}
+
+void CJoint::readRecord(const SIkObjectRecord& rec)
+{
+    readRecordMain(rec);
+    _jointType=rec.ints[IK_OBJECT_JOINT_TYPE];
+    _positionIsCyclic=SIM_IS_BIT_SET(rec.ints[IK_OBJECT_JOINT_FLAGS],0);
+    _jointMode=rec.ints[IK_OBJECT_JOINT_MODE];
+    _dependencyJointHandle=rec.ints[IK_OBJECT_JOINT_DEPENDENCY_HANDLE];
+    _screwPitch=rec.reals[IK_OBJECT_JOINT_SCREW_PITCH];
+    for (size_t i=0;i<4;i++)
+        _sphericalTransformation(i)=rec.reals[IK_OBJECT_JOINT_SPHERICAL_QUATERNION+i];
+    _jointMinPosition=rec.reals[IK_OBJECT_JOINT_MIN_POSITION];
+    _jointPositionRange=rec.reals[IK_OBJECT_JOINT_POSITION_RANGE];
+    _jointPosition=rec.reals[IK_OBJECT_JOINT_POSITION];
+    _maxStepSize=rec.reals[IK_OBJECT_JOINT_MAX_STEP_SIZE];
+    _ikWeight=rec.reals[IK_OBJECT_JOINT_IK_WEIGHT];
+    _dependencyJointMult=rec.reals[IK_OBJECT_JOINT_DEPENDENCY_MULT];
+    _dependencyJointAdd=rec.reals[IK_OBJECT_JOINT_DEPENDENCY_ADD];
+}
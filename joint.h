@@ -14,6 +14,10 @@ public:
     void announceIkGroupWillBeErased(int ikGroupHandle);
     void performSceneObjectLoadingMapping(const std::vector<int>* map);
     void serialize(CSerialization& ar);
+    void writeRecord(SIkObjectRecord& rec) const;
+    void readRecord(const SIkObjectRecord& rec);
+    CSceneObject* copyYourself() const;
+    void performObjectCopyMapping(const std::vector<CSceneObject*>& objectIndex);
 
     simReal getPosition(bool tempVals=false) const;
     void setPosition(simReal parameter,bool tempVals=false);
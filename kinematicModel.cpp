@@ -0,0 +1,551 @@
+#include "simConst.h"
+#include "kinematicModel.h"
+#include "objectContainer.h"
+#include "ikKernels.h"
+#ifdef IK_CHECK_BATCH_POSES
+#include <cassert>
+#include <limits>
+#endif
+
+CKinematicModel::CKinematicModel()
+{
+    _sweepFrom=0;
+    _version=0;
+}
+
+CKinematicModel::~CKinematicModel()
+{
+}
+
+unsigned int CKinematicModel::getVersion() const
+{
+    return(_version);
+}
+
+void CKinematicModel::setVersion(unsigned int topologyVersion)
+{ // For topology changes that were applied incrementally, or that do not affect the model
+    _version=topologyVersion;
+}
+
+void CKinematicModel::build(const CObjectContainer* container,unsigned int topologyVersion)
+{ // Depth-first from the orphans, so that parents always precede their children. Only the parent pointers
+  // are used (the child and orphan lists of the container are not up-to-date during a scene edit)
+    objects.clear();
+    parentIndices.clear();
+    indexOfHandle.assign(container->_objectIndex.size(),-1);
+    // Children in objectList order, stored contiguously by parent handle:
+    std::vector<size_t> firstChild(container->_objectIndex.size()+1,0);
+    std::vector<CSceneObject*> children(container->objectList.size());
+    std::vector<CSceneObject*> toVisit;
+    for (size_t i=0;i<container->objectList.size();i++)
+    {
+        CSceneObject* parent=container->getObject(container->objectList[i])->getParentObject();
+        if (parent!=nullptr)
+            firstChild[size_t(parent->getObjectHandle())+1]++;
+    }
+    for (size_t i=1;i<firstChild.size();i++)
+        firstChild[i]+=firstChild[i-1];
+    std::vector<size_t> childCnt(container->_objectIndex.size(),0);
+    for (size_t i=container->objectList.size();i>0;i--)
+    {
+        CSceneObject* it=container->getObject(container->objectList[i-1]);
+        CSceneObject* parent=it->getParentObject();
+        if (parent!=nullptr)
+        {
+            size_t p=size_t(parent->getObjectHandle());
+            children[firstChild[p]+childCnt[p]]=it;
+            childCnt[p]++;
+        }
+        else
+            toVisit.push_back(it);
+    }
+    // children of a parent are now in reverse objectList order, i.e. in the order they need to be pushed
+    while (toVisit.size()!=0)
+    {
+        CSceneObject* it=toVisit.back();
+        toVisit.pop_back();
+        int parentIndex=-1;
+        if (it->getParentObject()!=nullptr)
+            parentIndex=indexOfHandle[size_t(it->getParentObject()->getObjectHandle())];
+        size_t h=size_t(it->getObjectHandle());
+        indexOfHandle[h]=int(objects.size());
+        objects.push_back(it);
+        parentIndices.push_back(parentIndex);
+        for (size_t i=firstChild[h];i<firstChild[h+1];i++)
+            toVisit.push_back(children[i]);
+    }
+
+    size_t n=objects.size();
+    localPoses.resize(n);
+    jointTypes.resize(n);
+    screwPitches.resize(n);
+    jointPositions.resize(n);
+    sphericalRotations.resize(n);
+    worldPoses.resize(n);
+    for (size_t i=0;i<n;i++)
+        _gather(i);
+    _changedIndices.clear();
+    _changed.assign(n,0);
+    _sweepFrom=0;
+    _version=topologyVersion;
+}
+
+int CKinematicModel::_getIndex(const CSceneObject* object) const
+{ // -1 if the object is not part of the model
+    int handle=object->getObjectHandle();
+    if ( (handle<0)||(size_t(handle)>=indexOfHandle.size())||(indexOfHandle[size_t(handle)]==-1) )
+        return(-1);
+    int index=indexOfHandle[size_t(handle)];
+    if (objects[size_t(index)]!=object)
+        return(-1);
+    return(index);
+}
+
+bool CKinematicModel::appendObject(CSceneObject* object)
+{ // Constant time (amortized). Returns false if the model needs to be rebuilt instead
+    if (_version==0)
+        return(false);
+    int parentIndex=-1;
+    if (object->getParentObject()!=nullptr)
+    {
+        parentIndex=_getIndex(object->getParentObject());
+        if (parentIndex==-1)
+            return(false);
+    }
+    size_t handle=size_t(object->getObjectHandle());
+    if (handle>=indexOfHandle.size())
+        indexOfHandle.resize(handle+1,-1);
+    size_t index=objects.size();
+    indexOfHandle[handle]=int(index);
+    objects.push_back(object);
+    parentIndices.push_back(parentIndex);
+    localPoses.resize(index+1);
+    jointTypes.resize(index+1);
+    screwPitches.resize(index+1);
+    jointPositions.resize(index+1);
+    sphericalRotations.resize(index+1);
+    worldPoses.resize(index+1);
+    _changed.push_back(0);
+    _gather(index);
+    if (index<_sweepFrom)
+        _sweepFrom=index;
+    return(true);
+}
+
+bool CKinematicModel::announceParentChanged(const CSceneObject* object)
+{ // Constant time if the new parent precedes the object (e.g. when attaching a newly created object). Returns false if
+  // the model needs to be rebuilt instead
+    if (_version==0)
+        return(false);
+    int index=_getIndex(object);
+    if (index==-1)
+        return(false);
+    int parentIndex=-1;
+    if (object->getParentObject()!=nullptr)
+    {
+        parentIndex=_getIndex(object->getParentObject());
+        if ( (parentIndex==-1)||(parentIndex>index) )
+            return(false);
+    }
+    parentIndices[size_t(index)]=parentIndex;
+    announceObjectChanged(object);
+    return(true);
+}
+
+void CKinematicModel::announceObjectChanged(const CSceneObject* object)
+{ // Constant time. The object's values are read again with the next sweep
+    if (_version==0)
+        return;
+    int i=_getIndex(object);
+    if (i==-1)
+        return; // not yet part of the model. The model will be rebuilt anyway
+    size_t index=size_t(i);
+    if (_changed[index]==0)
+    {
+        _changed[index]=1;
+        _changedIndices.push_back(index);
+    }
+    if (index<_sweepFrom)
+        _sweepFrom=index;
+}
+
+void CKinematicModel::_gather(size_t index)
+{
+    const CSceneObject* it=objects[index];
+    localPoses[index]=it->getLocalTransformationPart1();
+    jointTypes[index]=-1;
+    if (it->getObjectType()==sim_object_joint_type)
+    {
+        const CJoint* joint=static_cast<const CJoint*>(it);
+        jointTypes[index]=joint->getJointType();
+        screwPitches[index]=joint->getScrewPitch();
+        jointPositions[index]=joint->getPosition();
+        sphericalRotations[index]=joint->getSphericalTransformation();
+    }
+}
+
+C7Vector CKinematicModel::_getLocalPose(size_t index) const
+{ // Same as CSceneObject::getLocalTransformation(false)
+    C7Vector local(localPoses[index]);
+    int type=jointTypes[index];
+    if (type!=-1)
+    {
+        C7Vector jointTr;
+        jointTr.setIdentity();
+        if (type==sim_joint_revolute_subtype)
+        {
+            jointTr.Q.setAngleAndAxis(jointPositions[index],C3Vector(simZero,simZero,simOne));
+            jointTr.X(2)=jointPositions[index]*screwPitches[index];
+        }
+        if (type==sim_joint_prismatic_subtype)
+            jointTr.X(2)=jointPositions[index];
+        if (type==sim_joint_spherical_subtype)
+            jointTr.Q=sphericalRotations[index];
+        local=CIkKernels::multiply(local,jointTr);
+    }
+    return(local);
+}
+
+void CKinematicModel::computeWorldPoses()
+{ // Single linear sweep, starting at the first changed entry
+    for (size_t i=0;i<_changedIndices.size();i++)
+    {
+        _gather(_changedIndices[i]);
+        _changed[_changedIndices[i]]=0;
+    }
+    _changedIndices.clear();
+    size_t n=objects.size();
+    for (size_t i=_sweepFrom;i<n;i++)
+    {
+        C7Vector local(_getLocalPose(i));
+        int parent=parentIndices[i];
+        if (parent==-1)
+            worldPoses[i]=local;
+        else
+            worldPoses[i]=CIkKernels::multiplyInChain(worldPoses[size_t(parent)],local);
+    }
+    _sweepFrom=n;
+}
+
+bool CKinematicModel::getWorldPose(const CSceneObject* object,C7Vector& pose) const
+{ // The world poses need to be up-to-date (i.e. call computeWorldPoses beforehand)
+    int index=_getIndex(object);
+    if (index==-1)
+        return(false);
+    pose=worldPoses[size_t(index)];
+    return(true);
+}
+
+bool CKinematicModel::precedes(const CSceneObject* object,const CSceneObject* otherObject) const
+{ // If true, object can't be a descendant of otherObject
+    int index=_getIndex(object);
+    int otherIndex=_getIndex(otherObject);
+    return( (index!=-1)&&(otherIndex!=-1)&&(index<otherIndex) );
+}
+
+// Batch kernel helpers. A block holds the poses of IK_BATCH_LANES configurations, stored as 7 rows
+// (qw,qx,qy,qz,x,y,z) of IK_BATCH_LANES values each, so that the loops below vectorize:
+static void _broadcastLanes(const C7Vector& tr,simReal* r)
+{
+    for (size_t l=0;l<IK_BATCH_LANES;l++)
+    {
+        r[0*IK_BATCH_LANES+l]=tr.Q(0);
+        r[1*IK_BATCH_LANES+l]=tr.Q(1);
+        r[2*IK_BATCH_LANES+l]=tr.Q(2);
+        r[3*IK_BATCH_LANES+l]=tr.Q(3);
+        r[4*IK_BATCH_LANES+l]=tr.X(0);
+        r[5*IK_BATCH_LANES+l]=tr.X(1);
+        r[6*IK_BATCH_LANES+l]=tr.X(2);
+    }
+}
+
+static void _multiplyLanes(const simReal* a,const simReal* b,simReal* r)
+{ // r=a*b, i.e. r.Q=a.Q*b.Q and r.X=a.X+a.Q*b.X
+    const simReal* aw=a+0*IK_BATCH_LANES;
+    const simReal* ax=a+1*IK_BATCH_LANES;
+    const simReal* ay=a+2*IK_BATCH_LANES;
+    const simReal* az=a+3*IK_BATCH_LANES;
+    const simReal* bw=b+0*IK_BATCH_LANES;
+    const simReal* bx=b+1*IK_BATCH_LANES;
+    const simReal* by=b+2*IK_BATCH_LANES;
+    const simReal* bz=b+3*IK_BATCH_LANES;
+    for (size_t l=0;l<IK_BATCH_LANES;l++)
+    {
+        // Rotated translation: v'=(w*w-u.u)*v+2*(u.v)*u+2*w*(u^v), with u the vector part of a.Q. Like C4Vector,
+        // this is q*v*q^-1 scaled by |q|^2, i.e. also valid for quaternions that are not exactly normalized:
+        simReal vx=b[4*IK_BATCH_LANES+l];
+        simReal vy=b[5*IK_BATCH_LANES+l];
+        simReal vz=b[6*IK_BATCH_LANES+l];
+        simReal s=aw[l]*aw[l]-(ax[l]*ax[l]+ay[l]*ay[l]+az[l]*az[l]);
+        simReal uv=simTwo*(ax[l]*vx+ay[l]*vy+az[l]*vz);
+        simReal w=simTwo*aw[l];
+        simReal rx=a[4*IK_BATCH_LANES+l]+(s*vx+uv*ax[l]+w*(ay[l]*vz-az[l]*vy));
+        simReal ry=a[5*IK_BATCH_LANES+l]+(s*vy+uv*ay[l]+w*(az[l]*vx-ax[l]*vz));
+        simReal rz=a[6*IK_BATCH_LANES+l]+(s*vz+uv*az[l]+w*(ax[l]*vy-ay[l]*vx));
+        simReal qw=aw[l]*bw[l]-ax[l]*bx[l]-ay[l]*by[l]-az[l]*bz[l];
+        simReal qx=aw[l]*bx[l]+ax[l]*bw[l]+ay[l]*bz[l]-az[l]*by[l];
+        simReal qy=aw[l]*by[l]-ax[l]*bz[l]+ay[l]*bw[l]+az[l]*bx[l];
+        simReal qz=aw[l]*bz[l]+ax[l]*by[l]-ay[l]*bx[l]+az[l]*bw[l];
+        r[0*IK_BATCH_LANES+l]=qw;
+        r[1*IK_BATCH_LANES+l]=qx;
+        r[2*IK_BATCH_LANES+l]=qy;
+        r[3*IK_BATCH_LANES+l]=qz;
+        r[4*IK_BATCH_LANES+l]=rx;
+        r[5*IK_BATCH_LANES+l]=ry;
+        r[6*IK_BATCH_LANES+l]=rz;
+    }
+}
+
+static void _jointLanes(int jointType,simReal screwPitch,const simReal* values,simReal* r)
+{ // Intrinsic transformation of a revolute or prismatic joint, for each lane value
+    for (size_t l=0;l<IK_BATCH_LANES;l++)
+    {
+        simReal v=values[l];
+        if (jointType==sim_joint_revolute_subtype)
+        {
+            r[0*IK_BATCH_LANES+l]=cos(v*simReal(0.5));
+            r[3*IK_BATCH_LANES+l]=sin(v*simReal(0.5));
+            r[6*IK_BATCH_LANES+l]=v*screwPitch;
+        }
+        else
+        {
+            r[0*IK_BATCH_LANES+l]=simOne;
+            r[3*IK_BATCH_LANES+l]=simZero;
+            r[6*IK_BATCH_LANES+l]=v;
+        }
+        r[1*IK_BATCH_LANES+l]=simZero;
+        r[2*IK_BATCH_LANES+l]=simZero;
+        r[4*IK_BATCH_LANES+l]=simZero;
+        r[5*IK_BATCH_LANES+l]=simZero;
+    }
+}
+
+void CKinematicModel::computeWorldPosesBatch(size_t frameCnt,const CSceneObject* const* frames,size_t jointCnt,const CJoint* const* joints,size_t configCnt,const simReal* configs,C7Vector* poses) const
+{   // configs is configCnt x jointCnt (row-major). poses is frameCnt x configCnt, and contains the absolute frame poses
+    // (i.e. as getCumulativeTransformationPart1) that the scene would have if the joint positions were set with CJoint::setPosition.
+    // Joints in dependent mode follow their master joint. The model itself is not modified.
+    // World poses need to be up-to-date (i.e. call computeWorldPoses beforehand)
+    size_t n=objects.size();
+
+    // 1. Joint values that vary with the configuration: the batch joints (not in dependent mode), then the joints depending on them:
+    std::vector<int> valueSlotOfEntry(n,-1);
+    std::vector<const CJoint*> valueJoints;
+    std::vector<int> valueSources;      // column in configs for the batch joints, value slot of the master joint for dependent joints
+    for (size_t j=0;j<jointCnt;j++)
+    {
+        size_t index=size_t(indexOfHandle[size_t(joints[j]->getObjectHandle())]);
+        if (joints[j]->getJointMode()!=sim_jointmode_dependent)
+        {
+            if (valueSlotOfEntry[index]==-1)
+            {
+                valueSlotOfEntry[index]=int(valueJoints.size());
+                valueJoints.push_back(joints[j]);
+                valueSources.push_back(int(j));
+            }
+            else
+                valueSources[size_t(valueSlotOfEntry[index])]=int(j); // last value wins, as with sequential sets
+        }
+    }
+    size_t batchJointCnt=valueJoints.size();
+    for (size_t s=0;s<valueJoints.size();s++)
+    {
+        for (size_t k=0;k<valueJoints[s]->dependentJoints.size();k++)
+        {
+            const CJoint* dep=valueJoints[s]->dependentJoints[k];
+            size_t index=size_t(indexOfHandle[size_t(dep->getObjectHandle())]);
+            if ( (dep->getJointMode()==sim_jointmode_dependent)&&(valueSlotOfEntry[index]==-1) )
+            {
+                valueSlotOfEntry[index]=int(valueJoints.size());
+                valueJoints.push_back(dep);
+                valueSources.push_back(int(s));
+            }
+        }
+    }
+
+    // 2. Entries needed for the frames, and which of them vary with the configuration:
+    std::vector<unsigned char> needed(n,0);
+    std::vector<size_t> frameIndices(frameCnt);
+    for (size_t f=0;f<frameCnt;f++)
+    {
+        frameIndices[f]=size_t(indexOfHandle[size_t(frames[f]->getObjectHandle())]);
+        int i=int(frameIndices[f]);
+        while ( (i!=-1)&&(needed[size_t(i)]==0) )
+        {
+            needed[size_t(i)]=1;
+            i=parentIndices[size_t(i)];
+        }
+    }
+    std::vector<int> laneSlotOfEntry(n,-1);
+    std::vector<size_t> varyingEntries;
+    for (size_t i=0;i<n;i++)
+    { // parents come first
+        if (needed[i]!=0)
+        {
+            int parent=parentIndices[i];
+            if ( (valueSlotOfEntry[i]!=-1)||((parent!=-1)&&(laneSlotOfEntry[size_t(parent)]!=-1)) )
+            {
+                laneSlotOfEntry[i]=int(varyingEntries.size());
+                varyingEntries.push_back(i);
+            }
+        }
+    }
+
+    // 3. Blocks of IK_BATCH_LANES configurations:
+    const size_t blockSize=7*IK_BATCH_LANES;
+    std::vector<simReal> values(valueJoints.size()*IK_BATCH_LANES);
+    std::vector<simReal> world(varyingEntries.size()*blockSize);
+    std::vector<simReal> parentTr(blockSize);
+    std::vector<simReal> localTr(blockSize);
+    std::vector<simReal> jointTr(blockSize);
+    for (size_t c0=0;c0<configCnt;c0+=IK_BATCH_LANES)
+    {
+        size_t laneCnt=IK_BATCH_LANES;
+        if (c0+laneCnt>configCnt)
+            laneCnt=configCnt-c0;
+        // Joint values, as CJoint::setPosition would set them. Unused lanes repeat the last configuration:
+        for (size_t s=0;s<valueJoints.size();s++)
+        {
+            const CJoint* joint=valueJoints[s];
+            simReal* v=&values[s*IK_BATCH_LANES];
+            for (size_t l=0;l<IK_BATCH_LANES;l++)
+            {
+                size_t lane=l;
+                if (lane>=laneCnt)
+                    lane=laneCnt-1;
+                if (s<batchJointCnt)
+                {
+                    v[l]=configs[(c0+lane)*jointCnt+size_t(valueSources[s])];
+                    if (joint->getPositionIsCyclic())
+                        v[l]=atan2(sin(v[l]),cos(v[l]));
+                    else
+                    {
+                        if (v[l]>joint->getPositionIntervalMin()+joint->getPositionIntervalRange())
+                            v[l]=joint->getPositionIntervalMin()+joint->getPositionIntervalRange();
+                        if (v[l]<joint->getPositionIntervalMin())
+                            v[l]=joint->getPositionIntervalMin();
+                    }
+                }
+                else // dependent joints are not clamped
+                    v[l]=values[size_t(valueSources[s])*IK_BATCH_LANES+l]*joint->getDependencyJointMult()+joint->getDependencyJointAdd();
+            }
+        }
+        // Forward kinematics of the varying entries:
+        for (size_t k=0;k<varyingEntries.size();k++)
+        {
+            size_t i=varyingEntries[k];
+            int parent=parentIndices[i];
+            const simReal* parentLanes=parentTr.data();
+            if ( (parent!=-1)&&(laneSlotOfEntry[size_t(parent)]!=-1) )
+                parentLanes=&world[size_t(laneSlotOfEntry[size_t(parent)])*blockSize];
+            else
+            {
+                C7Vector tr(C7Vector::identityTransformation);
+                if (parent!=-1)
+                    tr=worldPoses[size_t(parent)];
+                _broadcastLanes(tr,parentTr.data());
+            }
+            simReal* out=&world[k*blockSize];
+            if (valueSlotOfEntry[i]!=-1)
+            {
+                _broadcastLanes(localPoses[i],localTr.data());
+                _jointLanes(jointTypes[i],screwPitches[i],&values[size_t(valueSlotOfEntry[i])*IK_BATCH_LANES],jointTr.data());
+                _multiplyLanes(localTr.data(),jointTr.data(),out);
+                _multiplyLanes(parentLanes,out,localTr.data());
+                for (size_t m=0;m<blockSize;m++)
+                    out[m]=localTr[m];
+            }
+            else
+            { // constant local transformation:
+                _broadcastLanes(_getLocalPose(i),localTr.data());
+                _multiplyLanes(parentLanes,localTr.data(),out);
+            }
+        }
+        // Frame poses (without the intrinsic part for joints):
+        for (size_t f=0;f<frameCnt;f++)
+        {
+            size_t i=frameIndices[f];
+            int parent=parentIndices[i];
+            bool isJoint=(jointTypes[i]!=-1);
+            for (size_t l=0;l<laneCnt;l++)
+            {
+                C7Vector tr;
+                if ( (laneSlotOfEntry[i]==-1)||isJoint )
+                {
+                    if ( (parent!=-1)&&(laneSlotOfEntry[size_t(parent)]!=-1) )
+                    {
+                        const simReal* p=&world[size_t(laneSlotOfEntry[size_t(parent)])*blockSize];
+                        C7Vector parentPose;
+                        parentPose.Q=C4Vector(p[0*IK_BATCH_LANES+l],p[1*IK_BATCH_LANES+l],p[2*IK_BATCH_LANES+l],p[3*IK_BATCH_LANES+l]);
+                        parentPose.X=C3Vector(p[4*IK_BATCH_LANES+l],p[5*IK_BATCH_LANES+l],p[6*IK_BATCH_LANES+l]);
+                        tr=parentPose*localPoses[i];
+                    }
+                    else
+                    {
+                        if (isJoint)
+                        {
+                            tr=localPoses[i];
+                            if (parent!=-1)
+                                tr=worldPoses[size_t(parent)]*tr;
+                        }
+                        else
+                            tr=worldPoses[i];
+                    }
+                }
+                else
+                {
+                    const simReal* p=&world[size_t(laneSlotOfEntry[i])*blockSize];
+                    tr.Q=C4Vector(p[0*IK_BATCH_LANES+l],p[1*IK_BATCH_LANES+l],p[2*IK_BATCH_LANES+l],p[3*IK_BATCH_LANES+l]);
+                    tr.X=C3Vector(p[4*IK_BATCH_LANES+l],p[5*IK_BATCH_LANES+l],p[6*IK_BATCH_LANES+l]);
+                }
+                poses[f*configCnt+c0+l]=tr;
+            }
+        }
+#ifdef IK_CHECK_BATCH_POSES
+        // Same poses with the simMath operators, i.e. as CSceneObject::getCumulativeTransformationPart1 would give them:
+        std::vector<C7Vector> reference(n);
+        for (size_t l=0;l<laneCnt;l++)
+        {
+            for (size_t i=0;i<n;i++)
+            {
+                if (needed[i]!=0)
+                {
+                    C7Vector local(_getLocalPose(i));
+                    if (valueSlotOfEntry[i]!=-1)
+                    {
+                        simReal v=values[size_t(valueSlotOfEntry[i])*IK_BATCH_LANES+l];
+                        C7Vector jointTr;
+                        jointTr.setIdentity();
+                        if (jointTypes[i]==sim_joint_revolute_subtype)
+                        {
+                            jointTr.Q.setAngleAndAxis(v,C3Vector(simZero,simZero,simOne));
+                            jointTr.X(2)=v*screwPitches[i];
+                        }
+                        else
+                            jointTr.X(2)=v;
+                        local=localPoses[i]*jointTr;
+                    }
+                    reference[i]=local;
+                    if (parentIndices[i]!=-1)
+                        reference[i]=reference[size_t(parentIndices[i])]*local;
+                }
+            }
+            for (size_t f=0;f<frameCnt;f++)
+            {
+                size_t i=frameIndices[f];
+                C7Vector expected(reference[i]);
+                if (jointTypes[i]!=-1)
+                { // without the intrinsic part
+                    expected=localPoses[i];
+                    if (parentIndices[i]!=-1)
+                        expected=reference[size_t(parentIndices[i])]*expected;
+                }
+                const C7Vector& pose=poses[f*configCnt+c0+l];
+                simReal tolerance=std::numeric_limits<simReal>::epsilon()*simReal(1000.0)*(simOne+expected.X.getLength());
+                assert((pose.X-expected.X).getLength()<tolerance);
+                for (size_t k=0;k<4;k++)
+                    assert(fabs(pose.Q(k)-expected.Q(k))<tolerance);
+            }
+        }
+#endif
+    }
+}
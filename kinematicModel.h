@@ -0,0 +1,51 @@
+#pragma once
+
+#include "ik.h"
+#include <vector>
+#include "4Vector.h"
+#include "7Vector.h"
+
+class CSceneObject;
+class CJoint;
+class CObjectContainer;
+
+const size_t IK_BATCH_LANES=8; // configurations evaluated together by the batch FK kernel
+
+class CKinematicModel
+{
+public:
+    CKinematicModel();
+    virtual ~CKinematicModel();
+
+    void build(const CObjectContainer* container,unsigned int topologyVersion);
+    unsigned int getVersion() const;
+    void setVersion(unsigned int topologyVersion);
+    bool appendObject(CSceneObject* object);
+    bool announceParentChanged(const CSceneObject* object);
+    void announceObjectChanged(const CSceneObject* object);
+    void computeWorldPoses();
+    bool getWorldPose(const CSceneObject* object,C7Vector& pose) const;
+    bool precedes(const CSceneObject* object,const CSceneObject* otherObject) const;
+    void computeWorldPosesBatch(size_t frameCnt,const CSceneObject* const* frames,size_t jointCnt,const CJoint* const* joints,size_t configCnt,const simReal* configs,C7Vector* poses) const;
+
+    // Flattened scene (real values only), topologically sorted (a parent always comes before its children):
+    std::vector<CSceneObject*> objects;
+    std::vector<int> parentIndices;         // -1 for orphans
+    std::vector<C7Vector> localPoses;       // without the joint intrinsic part
+    std::vector<int> jointTypes;            // -1 if not a joint
+    std::vector<simReal> screwPitches;
+    std::vector<simReal> jointPositions;
+    std::vector<C4Vector> sphericalRotations;
+    std::vector<C7Vector> worldPoses;       // valid after computeWorldPoses
+    std::vector<int> indexOfHandle;         // -1 if there is no such object
+
+private:
+    void _gather(size_t index);
+    int _getIndex(const CSceneObject* object) const;
+    C7Vector _getLocalPose(size_t index) const;
+
+    std::vector<size_t> _changedIndices;    // entries to re-read from their object before the next sweep
+    std::vector<unsigned char> _changed;
+    size_t _sweepFrom;                      // world poses before that index are up-to-date
+    unsigned int _version;                  // topology version of the container when built. 0 means not built
+};
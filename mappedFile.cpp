@@ -0,0 +1,96 @@
+#include "mappedFile.h"
+#include <cstdint>
+#ifdef _WIN32
+    #include <windows.h>
+#else
+    #include <sys/mman.h>
+    #include <sys/stat.h>
+    #include <fcntl.h>
+    #include <unistd.h>
+#endif
+
+CMappedFile::CMappedFile()
+{
+    _data=nullptr;
+    _size=0;
+#ifdef _WIN32
+    _fileHandle=INVALID_HANDLE_VALUE;
+    _mappingHandle=nullptr;
+#endif
+}
+
+CMappedFile::~CMappedFile()
+{
+    close();
+}
+
+bool CMappedFile::open(const char* path)
+{ // Empty files cannot be mapped, and fail
+    close();
+#ifdef _WIN32
+    _fileHandle=CreateFileA(path,GENERIC_READ,FILE_SHARE_READ,nullptr,OPEN_EXISTING,FILE_FLAG_SEQUENTIAL_SCAN,nullptr);
+    if (_fileHandle!=INVALID_HANDLE_VALUE)
+    {
+        LARGE_INTEGER size;
+        if ( GetFileSizeEx(_fileHandle,&size)&&(size.QuadPart>0)&&((unsigned long long)size.QuadPart<=(unsigned long long)SIZE_MAX) )
+        {
+            _mappingHandle=CreateFileMappingA(_fileHandle,nullptr,PAGE_READONLY,0,0,nullptr);
+            if (_mappingHandle!=nullptr)
+            {
+                _data=static_cast<const unsigned char*>(MapViewOfFile(_mappingHandle,FILE_MAP_READ,0,0,0));
+                if (_data!=nullptr)
+                    _size=size_t(size.QuadPart);
+            }
+        }
+    }
+#else
+    int fd=::open(path,O_RDONLY);
+    if (fd!=-1)
+    {
+        struct stat st;
+        if ( (fstat(fd,&st)==0)&&(st.st_size>0) )
+        {
+            void* data=mmap(nullptr,size_t(st.st_size),PROT_READ,MAP_SHARED,fd,0);
+            if (data!=MAP_FAILED)
+            {
+                madvise(data,size_t(st.st_size),MADV_SEQUENTIAL);
+                _data=static_cast<const unsigned char*>(data);
+                _size=size_t(st.st_size);
+            }
+        }
+        ::close(fd); // the mapping stays valid
+    }
+#endif
+    if (_data==nullptr)
+        close();
+    return(_data!=nullptr);
+}
+
+void CMappedFile::close()
+{
+#ifdef _WIN32
+    if (_data!=nullptr)
+        UnmapViewOfFile(_data);
+    if (_mappingHandle!=nullptr)
+        CloseHandle(_mappingHandle);
+    if (_fileHandle!=INVALID_HANDLE_VALUE)
+        CloseHandle(_fileHandle);
+    _fileHandle=INVALID_HANDLE_VALUE;
+    _mappingHandle=nullptr;
+#else
+    if (_data!=nullptr)
+        munmap(const_cast<unsigned char*>(_data),_size);
+#endif
+    _data=nullptr;
+    _size=0;
+}
+
+const unsigned char* CMappedFile::getData() const
+{
+    return(_data);
+}
+
+size_t CMappedFile::getSize() const
+{
+    return(_size);
+}
@@ -0,0 +1,23 @@
+#pragma once
+
+#include <cstddef>
+
+class CMappedFile
+{ // Read-only memory mapping of a whole file. The pages are shared with other processes mapping the same file
+public:
+    CMappedFile();
+    virtual ~CMappedFile();
+
+    bool open(const char* path);
+    void close();
+    const unsigned char* getData() const;
+    size_t getSize() const;
+
+private:
+    const unsigned char* _data;
+    size_t _size;
+#ifdef _WIN32
+    void* _fileHandle;
+    void* _mappingHandle;
+#endif
+};
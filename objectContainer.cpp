@@ -1,10 +1,20 @@
 #include "objectContainer.h"
 #include "app.h"
 #include "simConst.h"
+#include <algorithm>
+#ifdef IK_CHECK_OBJECT_INFORMATION
+#include <cassert>
+#endif
 
 CObjectContainer::CObjectContainer()
 {
     _nextObjectHandle=0;
+    _topologyVersion=1;
+    _nextCreationStamp=0;
+    _deferObjectInformation=false;
+    _editingScene=false;
+    _erasingObject=false;
+    _concurrentAccess=false;
     newSceneProcedure();
 }
 
@@ -13,6 +23,31 @@ CObjectContainer::~CObjectContainer()
     removeAllObjects();
 }
 
+CObjectContainer* CObjectContainer::copyYourself() const
+{ // Deep copy, with the same handles. The flattened kinematic model is rebuilt when first needed
+    CObjectContainer* newContainer=new CObjectContainer();
+    newContainer->_nextObjectHandle=_nextObjectHandle;
+    newContainer->orphanList=orphanList;
+    newContainer->objectList=objectList;
+    newContainer->jointList=jointList;
+    newContainer->dummyList=dummyList;
+    newContainer->_topologyVersion=_topologyVersion;
+    newContainer->_freeObjectHandles=_freeObjectHandles;
+    newContainer->_creationStamps=_creationStamps;
+    newContainer->_nextCreationStamp=_nextCreationStamp;
+    newContainer->_objectHandlesByName=_objectHandlesByName;
+    newContainer->_objectNameCnts=_objectNameCnts;
+    newContainer->_objectIndex.resize(_objectIndex.size(),nullptr);
+    for (size_t i=0;i<objectList.size();i++)
+    {
+        size_t handle=size_t(objectList[i]);
+        newContainer->_objectIndex[handle]=_objectIndex[handle]->copyYourself();
+    }
+    for (size_t i=0;i<objectList.size();i++)
+        newContainer->_objectIndex[size_t(objectList[i])]->performObjectCopyMapping(newContainer->_objectIndex);
+    return(newContainer);
+}
+
 void CObjectContainer::newSceneProcedure()
 {
     removeAllObjects();
@@ -33,6 +68,9 @@ void CObjectContainer::removeAllObjects()
     objectList.clear();
 
     _objectIndex.clear();
+    _freeObjectHandles=std::priority_queue<int,std::vector<int>,std::greater<int> >();
+    _objectHandlesByName.clear();
+    _objectNameCnts.clear();
 
 
     jointList.clear();
@@ -55,20 +93,16 @@ bool CObjectContainer::makeObjectChildOf(CSceneObject* childObject,CSceneObject*
         C7Vector oldAbsoluteTransf(childObject->getCumulativeTransformationPart1());
         childObject->setParentObject(nullptr);
         childObject->setLocalTransformation(oldAbsoluteTransf);
-        actualizeObjectInformation();
         return(true);
     }
-    // Illegal loop checking:
-    if (parentObject->isObjectAffiliatedWith(childObject))
+    // Illegal loop checking (a parent preceding the child in the flattened model can't be a descendant):
+    bool modelValid=(_kinematicModel.getVersion()==_topologyVersion);
+    if ( ((!modelValid)||(!_kinematicModel.precedes(parentObject,childObject)))&&parentObject->isObjectAffiliatedWith(childObject) )
         return(false);
     C7Vector oldAbsoluteTransf(childObject->getCumulativeTransformationPart1());
     C7Vector parentInverse(parentObject->getCumulativeTransformation().getInverse());
     childObject->setLocalTransformation(parentInverse*oldAbsoluteTransf);
     childObject->setParentObject(parentObject);
-
-    
-
-    actualizeObjectInformation();
     return(true);
 }
 
@@ -88,67 +122,277 @@ void CObjectContainer::setAbsoluteConfiguration(int objectHandle,const C7Vector&
     }
 }
 
-void CObjectContainer::actualizeObjectInformation()
+unsigned int CObjectContainer::getTopologyVersion() const
 {
-    // Actualize each object's child list
-    // Following rewritten on 2009/03/15 to make it faster:
+    return(_topologyVersion);
+}
+
+void CObjectContainer::incrementTopologyVersion(bool kinematicModelAffected/*=true*/)
+{ // Invalidates the chain plans of all IK elements, and the flattened kinematic model if affected
+    bool keepModel=( (!kinematicModelAffected)&&(_kinematicModel.getVersion()==_topologyVersion) );
+    _topologyVersion++;
+    if (_topologyVersion==0)
+        _topologyVersion=1;
+    if (keepModel)
+        _kinematicModel.setVersion(_topologyVersion);
+}
+
+void CObjectContainer::beginSceneEdit()
+{ // Until endSceneEdit, the orphan, joint and dummy lists are not updated (removing entries from them is not constant time).
+  // Child lists and dependent joint lists stay up-to-date
+    _editingScene=true;
+}
+
+void CObjectContainer::endSceneEdit()
+{
+    _editingScene=false;
+    actualizeObjectInformation();
+}
+
+bool CObjectContainer::isEditingScene() const
+{
+    return(_editingScene);
+}
+
+void CObjectContainer::announceObjectMoved(const CSceneObject* object)
+{ // The local transformation (real values) of object changed
+    if (_concurrentAccess)
+    {
+        std::lock_guard<std::mutex> lock(_announceMutex);
+        _kinematicModel.announceObjectChanged(object);
+    }
+    else
+        _kinematicModel.announceObjectChanged(object);
+}
+
+void CObjectContainer::setConcurrentAccess(bool concurrent)
+{ // Only set while no other thread accesses the container
+    _concurrentAccess=concurrent;
+}
+
+bool CObjectContainer::getWorldTransformation(const CSceneObject* object,C7Vector& tr)
+{ // Reads the pose (real values) from the flattened model, which is rebuilt if the topology changed, and swept if something moved
+    if (_kinematicModel.getVersion()!=_topologyVersion)
+        _kinematicModel.build(this,_topologyVersion);
+    _kinematicModel.computeWorldPoses();
+    return(_kinematicModel.getWorldPose(object,tr));
+}
+
+void CObjectContainer::getWorldTransformationsBatch(size_t frameCnt,const CSceneObject* const* frames,size_t jointCnt,const CJoint* const* joints,size_t configCnt,const simReal* configs,C7Vector* poses)
+{ // Poses of the frames for each joint configuration. The scene is not modified
+    if (_kinematicModel.getVersion()!=_topologyVersion)
+        _kinematicModel.build(this,_topologyVersion);
+    _kinematicModel.computeWorldPoses();
+    _kinematicModel.computeWorldPosesBatch(frameCnt,frames,jointCnt,joints,configCnt,configs,poses);
+}
+
+void CObjectContainer::actualizeObjectInformation()
+{ // Full rebuild. Normally, the information is updated incrementally with each change
+    incrementTopologyVersion();
+    std::vector<std::vector<CSceneObject*> > childLists;
+    std::vector<std::vector<CJoint*> > dependentJointLists;
+    _computeObjectInformation(childLists,jointList,dummyList,orphanList,dependentJointLists);
     for (size_t i=0;i<objectList.size();i++)
     {
-        CSceneObject* it=_objectIndex[size_t(objectList[i])];
-        it->childList.clear();
+        size_t handle=size_t(objectList[i]);
+        _objectIndex[handle]->childList.swap(childLists[handle]);
+        if (_objectIndex[handle]->getObjectType()==sim_object_joint_type)
+            static_cast<CJoint*>(_objectIndex[handle])->dependentJoints.swap(dependentJointLists[handle]);
     }
+}
+
+void CObjectContainer::_computeObjectInformation(std::vector<std::vector<CSceneObject*> >& childLists,std::vector<int>& joints,std::vector<int>& dummies,std::vector<int>& orphans,std::vector<std::vector<CJoint*> >& dependentJointLists) const
+{ // Child lists and dependent joint lists are indexed by object handle
+    childLists.assign(_objectIndex.size(),std::vector<CSceneObject*>());
+    dependentJointLists.assign(_objectIndex.size(),std::vector<CJoint*>());
+    joints.clear();
+    dummies.clear();
+    orphans.clear();
     for (size_t i=0;i<objectList.size();i++)
     {
         CSceneObject* it=_objectIndex[size_t(objectList[i])];
         CSceneObject* parent=it->getParentObject();
         if (parent!=nullptr)
-            parent->childList.push_back(it);
+            childLists[size_t(parent->getObjectHandle())].push_back(it);
+        else
+            orphans.push_back(objectList[i]);
+        if (it->getObjectType()==sim_object_joint_type)
+            joints.push_back(objectList[i]);
+        if (it->getObjectType()==sim_object_dummy_type)
+            dummies.push_back(objectList[i]);
     }
+    for (size_t i=0;i<joints.size();i++)
+    {
+        CJoint* it=getJoint(joints[i]);
+        CJoint* master=getDependencyMaster(it);
+        if (master!=nullptr)
+            dependentJointLists[size_t(master->getObjectHandle())].push_back(it);
+    }
+}
 
-    // Actualize the light, graph, sensor & joint list
-    jointList.clear();
-    dummyList.clear();
-    orphanList.clear();
-
+bool CObjectContainer::_checkObjectInformation() const
+{ // Compares the incrementally updated information with a full rebuild (only the pointer lists during a scene edit)
+    std::vector<std::vector<CSceneObject*> > childLists;
+    std::vector<int> joints;
+    std::vector<int> dummies;
+    std::vector<int> orphans;
+    std::vector<std::vector<CJoint*> > dependentJointLists;
+    _computeObjectInformation(childLists,joints,dummies,orphans,dependentJointLists);
+    bool retVal=( _editingScene||((joints==jointList)&&(dummies==dummyList)&&(orphans==orphanList)) );
     for (size_t i=0;i<objectList.size();i++)
     {
-        if (_objectIndex[size_t(objectList[i])]->getObjectType()==sim_object_joint_type)
-            jointList.push_back(objectList[i]);
-        if (_objectIndex[size_t(objectList[i])]->getObjectType()==sim_object_dummy_type)
-            dummyList.push_back(objectList[i]);
-        if (_objectIndex[size_t(objectList[i])]->getParentObject()==nullptr)
-            orphanList.push_back(objectList[i]);
+        size_t handle=size_t(objectList[i]);
+        if (_objectIndex[handle]->childList!=childLists[handle])
+            retVal=false;
+        if ( (_objectIndex[handle]->getObjectType()==sim_object_joint_type)&&(static_cast<CJoint*>(_objectIndex[handle])->dependentJoints!=dependentJointLists[handle]) )
+            retVal=false;
     }
-    // We actualize the direct linked joint list of each joint: (2009-01-27)
-    for (size_t i=0;i<jointList.size();i++)
+    return(retVal);
+}
+
+template<class T>
+void CObjectContainer::_eraseFromBack(std::vector<T>& list,const T& item)
+{ // Recently created or moved objects are usually near the end
+    for (size_t i=list.size();i>0;i--)
     {
-        CJoint* it=getJoint(jointList[i]);
-        it->dependentJoints.clear();
-        for (size_t j=0;j<jointList.size();j++)
+        if (list[i-1]==item)
         {
-            CJoint* anAct=getJoint(App::currentInstance->objectContainer->jointList[j]);
-            if (anAct!=it)
-            {
-                if (anAct->getJointMode()==sim_jointmode_dependent)
-                {
-                    if (anAct->getDependencyJointHandle()==it->getObjectHandle())
-                        it->dependentJoints.push_back(anAct);
-                }
-            }
+            list.erase(list.begin()+(i-1));
+            break;
         }
     }
 }
 
-int CObjectContainer::getObjectHandle(const std::string& objectName) const
+void CObjectContainer::_insertInCreationOrder(std::vector<int>& list,int objectHandle) const
 {
-    for (size_t i=0;i<objectList.size();i++)
+    size_t i=list.size();
+    while ( (i>0)&&(_creationStamps[size_t(list[i-1])]>_creationStamps[size_t(objectHandle)]) )
+        i--;
+    list.insert(list.begin()+i,objectHandle);
+}
+
+void CObjectContainer::_insertInCreationOrder(std::vector<CSceneObject*>& list,CSceneObject* object) const
+{
+    size_t i=list.size();
+    while ( (i>0)&&(_creationStamps[size_t(list[i-1]->getObjectHandle())]>_creationStamps[size_t(object->getObjectHandle())]) )
+        i--;
+    list.insert(list.begin()+i,object);
+}
+
+void CObjectContainer::_insertInCreationOrder(std::vector<CJoint*>& list,CJoint* joint) const
+{
+    size_t i=list.size();
+    while ( (i>0)&&(_creationStamps[size_t(list[i-1]->getObjectHandle())]>_creationStamps[size_t(joint->getObjectHandle())]) )
+        i--;
+    list.insert(list.begin()+i,joint);
+}
+
+void CObjectContainer::announceObjectParentChanged(CSceneObject* object,CSceneObject* previousParent)
+{ // Called for objects of the container only
+    bool modelValid=(_kinematicModel.getVersion()==_topologyVersion);
+    incrementTopologyVersion();
+    if ( modelValid&&_kinematicModel.announceParentChanged(object) )
+        _kinematicModel.setVersion(_topologyVersion);
+    if (_deferObjectInformation)
+        return;
+    if (previousParent!=nullptr)
+        _eraseFromBack(previousParent->childList,object);
+    else if (!_editingScene)
+        _eraseFromBack(orphanList,object->getObjectHandle());
+    if (object->getParentObject()!=nullptr)
+        _insertInCreationOrder(object->getParentObject()->childList,object);
+    else if (!_editingScene)
+        _insertInCreationOrder(orphanList,object->getObjectHandle());
+#ifdef IK_CHECK_OBJECT_INFORMATION
+    if (!_erasingObject)
+        assert(_checkObjectInformation());
+#endif
+}
+
+CJoint* CObjectContainer::getDependencyMaster(const CJoint* joint) const
+{ // The joint is in the dependentJoints list of the returned joint
+    CJoint* retVal=nullptr;
+    if ( (joint->getJointMode()==sim_jointmode_dependent)&&(joint->getDependencyJointHandle()!=-1) )
+    {
+        retVal=getJoint(joint->getDependencyJointHandle());
+        if (retVal==joint)
+            retVal=nullptr;
+    }
+    return(retVal);
+}
+
+void CObjectContainer::announceJointDependencyChanged(CJoint* joint,CJoint* previousMaster)
+{ // Called for joints of the container only. previousMaster is getDependencyMaster before the change
+    if (_deferObjectInformation)
+    {
+        incrementTopologyVersion(false);
+        return;
+    }
+    CJoint* master=getDependencyMaster(joint);
+    if (master!=previousMaster)
     {
-        if (_objectIndex[size_t(objectList[i])]->getObjectName().compare(objectName)==0)
-            return(objectList[i]);
+        incrementTopologyVersion(false);
+        if (previousMaster!=nullptr)
+        {
+            std::vector<CJoint*>& dependents=previousMaster->dependentJoints;
+            dependents.erase(std::find(dependents.begin(),dependents.end(),joint));
+        }
+        if (master!=nullptr)
+            _insertInCreationOrder(master->dependentJoints,joint);
     }
+#ifdef IK_CHECK_OBJECT_INFORMATION
+    if (!_erasingObject)
+        assert(_checkObjectInformation());
+#endif
+}
+
+int CObjectContainer::getObjectHandle(const std::string& objectName) const
+{
+    std::unordered_map<std::string,int>::const_iterator it=_objectHandlesByName.find(objectName);
+    if (it!=_objectHandlesByName.end())
+        return(it->second);
     return(-1);
 }
 
+void CObjectContainer::_addObjectName(const std::string& name,int objectHandle)
+{ // objectList is ordered by creation stamp
+    _objectNameCnts[name]++;
+    std::unordered_map<std::string,int>::iterator it=_objectHandlesByName.find(name);
+    if (it==_objectHandlesByName.end())
+        _objectHandlesByName[name]=objectHandle;
+    else if (_creationStamps[size_t(objectHandle)]<_creationStamps[size_t(it->second)])
+        it->second=objectHandle;
+}
+
+void CObjectContainer::_removeObjectName(const std::string& name,int objectHandle)
+{
+    std::unordered_map<std::string,size_t>::iterator cnt=_objectNameCnts.find(name);
+    cnt->second--;
+    if (cnt->second==0)
+    {
+        _objectNameCnts.erase(cnt);
+        _objectHandlesByName.erase(name);
+    }
+    else if (_objectHandlesByName[name]==objectHandle)
+    { // the next object in objectList with that name:
+        for (size_t i=0;i<objectList.size();i++)
+        {
+            int h=objectList[i];
+            if ( (h!=objectHandle)&&(_objectIndex[size_t(h)]->getObjectName()==name) )
+            {
+                _objectHandlesByName[name]=h;
+                break;
+            }
+        }
+    }
+}
+
+void CObjectContainer::announceObjectNameWillChange(const CSceneObject* object,const std::string& newName)
+{ // Called for objects of the container only
+    _removeObjectName(object->getObjectName(),object->getObjectHandle());
+    _addObjectName(newName,object->getObjectHandle());
+}
+
 int CObjectContainer::getHighestObjectHandle() const
 {
     int highest=-1;
@@ -218,6 +462,7 @@ bool CObjectContainer::eraseObject(CSceneObject* it)
         return(false);
 
     // We announce the object will be erased:
+    _erasingObject=true;
     announceObjectWillBeErased(it->getObjectHandle()); // this may trigger other "eraseObject" calls (not really, since we don't have versatiles anymore!)
     // We remove the object from the object list
     size_t i;
@@ -227,10 +472,40 @@ bool CObjectContainer::eraseObject(CSceneObject* it)
             break;
     }
     objectList.erase(objectList.begin()+i);
+    _removeObjectName(it->getObjectName(),it->getObjectHandle());
+    // Update the information (children were already moved to the parent of the object):
+    incrementTopologyVersion();
+    if (!_deferObjectInformation)
+    {
+        if (it->getParentObject()!=nullptr)
+            _eraseFromBack(it->getParentObject()->childList,it);
+        else if (!_editingScene)
+            _eraseFromBack(orphanList,it->getObjectHandle());
+        if (it->getObjectType()==sim_object_joint_type)
+        {
+            CJoint* master=getDependencyMaster(static_cast<CJoint*>(it));
+            if (master!=nullptr)
+            {
+                std::vector<CJoint*>& dependents=master->dependentJoints;
+                std::vector<CJoint*>::iterator dep=std::find(dependents.begin(),dependents.end(),static_cast<CJoint*>(it));
+                if (dep!=dependents.end())
+                    dependents.erase(dep);
+            }
+            if (!_editingScene)
+                _eraseFromBack(jointList,it->getObjectHandle());
+        }
+        if ( (it->getObjectType()==sim_object_dummy_type)&&(!_editingScene) )
+            _eraseFromBack(dummyList,it->getObjectHandle());
+    }
     // Now remove the object from the index
     _objectIndex[size_t(it->getObjectHandle())]=nullptr;
+    _freeObjectHandles.push(it->getObjectHandle());
     delete it;
-    actualizeObjectInformation();
+    _erasingObject=false;
+#ifdef IK_CHECK_OBJECT_INFORMATION
+    if (!_deferObjectInformation)
+        assert(_checkObjectInformation());
+#endif
 
     return(true);
 }
@@ -260,55 +535,225 @@ void CObjectContainer::announceIkGroupWillBeErased(int ikGroupHandle)
     App::currentInstance->ikGroupContainer->announceIkGroupWillBeErased(ikGroupHandle); // This will never trigger an Ik group destruction
 }
 
-void CObjectContainer::importKinematicsData(CSerialization& ar)
-{
+static bool _hasLoop(const std::vector<int>& nextHandles)
+{ // nextHandles[h] is the handle that follows h (e.g. its parent), or -1. Linear time, since each handle is walked once
+    std::vector<unsigned char> states(nextHandles.size(),0); // 1: on the current walk, 2: known to end without loop
+    std::vector<size_t> walk;
+    for (size_t i=0;i<nextHandles.size();i++)
+    {
+        walk.clear();
+        int h=int(i);
+        while ( (h>=0)&&(size_t(h)<nextHandles.size())&&(states[size_t(h)]==0) )
+        {
+            states[size_t(h)]=1;
+            walk.push_back(size_t(h));
+            h=nextHandles[size_t(h)];
+        }
+        if ( (h>=0)&&(size_t(h)<nextHandles.size())&&(states[size_t(h)]==1) )
+            return(true);
+        for (size_t j=0;j<walk.size();j++)
+            states[walk[j]]=2;
+    }
+    return(false);
+}
+
+static bool _getRecordName(const CSerialization& ar,int nameOffset,size_t stringTablePos,size_t stringTableSize,std::string& name)
+{ // Records refer to their name with its offset in the string table
+    if ( (nameOffset<0)||(size_t(nameOffset)>=stringTableSize) )
+        return(false);
+    return(ar.getStringAt(stringTablePos+size_t(nameOffset),name));
+}
+
+bool CObjectContainer::importKinematicsData(CSerialization& ar)
+{ // Reads the format exported by CoppeliaSim, or the one written by exportKinematicsData. Returns false for truncated or
+  // invalid data, in which case the environment is left empty
     removeAllObjects();
     App::currentInstance->ikGroupContainer->removeAllIkGroups(); // just in case
 
+    _deferObjectInformation=true; // handles are only consistent once the loading mapping was applied
     int versionNumber=ar.readInt(); // this is the ext IK serialization version. Not forward nor backward compatible!
 
-    int objCnt=ar.readInt();
+    // The binary format starts with a header that gives the size of every section:
+    bool binaryFormat=(versionNumber==IK_BINARY_FORMAT_MAGIC);
+    int header[IK_BINARY_HEADER_INTS];
+    size_t realSize=0;
+    size_t stringTablePos=0;
+    size_t stringTableSize=0;
+    bool ok=true;
+    int objCnt=0;
+    if (binaryFormat)
+    {
+        header[IK_BINARY_HEADER_MAGIC]=versionNumber;
+        ar.readInts(header+1,IK_BINARY_HEADER_INTS-1);
+        realSize=size_t(header[IK_BINARY_HEADER_REAL_SIZE]);
+        ok=( (!ar.hasFailed())&&(header[IK_BINARY_HEADER_VERSION]==IK_BINARY_FORMAT_VERSION)&&((realSize==sizeof(float))||(realSize==sizeof(double))) );
+        for (size_t i=IK_BINARY_HEADER_OBJECT_CNT;i<=IK_BINARY_HEADER_STRING_TABLE_SIZE;i++)
+            ok=ok&&(header[i]>=0);
+        if (ok)
+        {
+            unsigned long long recordsSize=(unsigned long long)header[IK_BINARY_HEADER_OBJECT_CNT]*(IK_OBJECT_RECORD_INTS*sizeof(int)+IK_OBJECT_RECORD_REALS*realSize);
+            recordsSize+=(unsigned long long)header[IK_BINARY_HEADER_IKGROUP_CNT]*(IK_GROUP_RECORD_INTS*sizeof(int)+IK_GROUP_RECORD_REALS*realSize);
+            recordsSize+=(unsigned long long)header[IK_BINARY_HEADER_IKELEMENT_CNT]*(IK_ELEMENT_RECORD_INTS*sizeof(int)+IK_ELEMENT_RECORD_REALS*realSize);
+            stringTableSize=size_t(header[IK_BINARY_HEADER_STRING_TABLE_SIZE]);
+            ok=(recordsSize+stringTableSize==ar.getRemainingSize());
+            stringTablePos=IK_BINARY_HEADER_INTS*sizeof(int)+size_t(recordsSize);
+        }
+        objCnt=header[IK_BINARY_HEADER_OBJECT_CNT];
+    }
+    else
+        objCnt=ar.readInt();
+    ok=( ok&&(!ar.hasFailed())&&(objCnt>=0) );
 
     std::vector<int> objectMapping;
-    for (int i=0;i<objCnt;i++)
+    if ( ok&&(objCnt>0) )
+    { // an object takes more than an int in the stream, which bounds the reservation for invalid counts:
+        size_t cnt=std::min<size_t>(size_t(objCnt),ar.getRemainingSize()/sizeof(int));
+        objectMapping.reserve(2*cnt);
+        objectList.reserve(cnt);
+        _objectIndex.reserve(cnt);
+        _creationStamps.reserve(cnt);
+        _objectHandlesByName.reserve(cnt);
+    }
+    for (int i=0;ok&&(i<objCnt);i++)
     {
-        int objType=ar.readInt();
-
         CSceneObject* it;
-
-        if (objType==sim_object_joint_type)
+        if (binaryFormat)
         {
-            CJoint* joint=new CJoint(sim_joint_revolute_subtype);
-            joint->serialize(ar);
-            it=joint;
+            SIkObjectRecord rec;
+            ar.readInts(rec.ints,IK_OBJECT_RECORD_INTS);
+            ar.readReals(rec.reals,IK_OBJECT_RECORD_REALS,realSize);
+            std::string name;
+            ok=_getRecordName(ar,rec.ints[IK_OBJECT_NAME],stringTablePos,stringTableSize,name);
+            if (rec.ints[IK_OBJECT_TYPE]==sim_object_joint_type)
+                it=new CJoint(sim_joint_revolute_subtype);
+            else
+                it=new CDummy();
+            it->readRecord(rec);
+            it->setObjectName(name);
         }
         else
         {
-            CDummy* dum=new CDummy();
-            dum->serialize(ar);
-            it=dum;
+            int objType=ar.readInt();
+            if (objType==sim_object_joint_type)
+            {
+                CJoint* joint=new CJoint(sim_joint_revolute_subtype);
+                joint->serialize(ar);
+                it=joint;
+            }
+            else
+            {
+                CDummy* dum=new CDummy();
+                dum->serialize(ar);
+                it=dum;
+            }
+        }
+        if ( (!ok)||ar.hasFailed() )
+        {
+            delete it;
+            ok=false;
+            break;
         }
         objectMapping.push_back(it->getObjectHandle());
         addObjectToScene(it);
         objectMapping.push_back(it->getObjectHandle());
     }
 
-    // We do it the slow way (in order not to use too much RAM)
-    // prepareFastLoadingMapping(objectMapping);
+    prepareFastLoadingMapping(objectMapping);
 
+    // Parent loops are rejected before they exist, since most operations (erasing included) walk up the parents:
+    std::vector<int> nextHandles(_objectIndex.size(),-1);
     for (size_t i=0;i<objectList.size();i++)
+        nextHandles[size_t(objectList[i])]=_getLoadingMapping(&objectMapping,getObject(objectList[i])->getLoadedParentObjectHandle());
+    if ( ok&&_hasLoop(nextHandles) )
+        ok=false;
+
+    if (ok)
     {
-        CSceneObject* it=getObject(objectList[i]);
-        it->performSceneObjectLoadingMapping(&objectMapping);
+        for (size_t i=0;i<objectList.size();i++)
+        {
+            CSceneObject* it=getObject(objectList[i]);
+            it->performSceneObjectLoadingMapping(&objectMapping);
+        }
     }
+    _deferObjectInformation=false;
+    actualizeObjectInformation();
 
-    int ikGroupCnt=ar.readInt();
+    if (ok)
+    { // Dependency loops:
+        nextHandles.assign(_objectIndex.size(),-1);
+        for (size_t i=0;i<jointList.size();i++)
+        {
+            CJoint* master=getDependencyMaster(getJoint(jointList[i]));
+            if (master!=nullptr)
+                nextHandles[size_t(jointList[i])]=master->getObjectHandle();
+        }
+        ok=!_hasLoop(nextHandles);
+    }
 
-    for (int i=0;i<ikGroupCnt;i++)
+    if (binaryFormat)
+    { // All group records come first, then the element records of all groups, in the same order:
+        std::vector<CikGroup*> groups;
+        int elementCnt=0;
+        for (int i=0;ok&&(i<header[IK_BINARY_HEADER_IKGROUP_CNT]);i++)
+        {
+            SIkGroupRecord rec;
+            ar.readInts(rec.ints,IK_GROUP_RECORD_INTS);
+            ar.readReals(rec.reals,IK_GROUP_RECORD_REALS,realSize);
+            std::string name;
+            ok=( _getRecordName(ar,rec.ints[IK_GROUP_NAME],stringTablePos,stringTableSize,name)&&(!ar.hasFailed()) );
+            ok=( ok&&(rec.ints[IK_GROUP_ELEMENT_CNT]>=0)&&(rec.ints[IK_GROUP_ELEMENT_CNT]<=header[IK_BINARY_HEADER_IKELEMENT_CNT]-elementCnt) );
+            if (ok)
+            {
+                CikGroup* it=new CikGroup();
+                it->readRecord(rec);
+                it->setObjectName(name);
+                groups.push_back(it);
+                elementCnt+=rec.ints[IK_GROUP_ELEMENT_CNT];
+                for (int j=0;j<rec.ints[IK_GROUP_ELEMENT_CNT];j++)
+                    it->ikElements.push_back(new CikElement(-1));
+            }
+        }
+        ok=( ok&&(elementCnt==header[IK_BINARY_HEADER_IKELEMENT_CNT]) );
+        for (size_t i=0;ok&&(i<groups.size());i++)
+        {
+            for (size_t j=0;j<groups[i]->ikElements.size();j++)
+            {
+                SIkElementRecord rec;
+                ar.readInts(rec.ints,IK_ELEMENT_RECORD_INTS);
+                ar.readReals(rec.reals,IK_ELEMENT_RECORD_REALS,realSize);
+                groups[i]->ikElements[j]->readRecord(rec);
+            }
+            ok=!ar.hasFailed();
+        }
+        for (size_t i=0;i<groups.size();i++)
+        {
+            if (ok)
+                App::currentInstance->ikGroupContainer->addIkGroup(groups[i]);
+            else
+                delete groups[i];
+        }
+    }
+    else
     {
-        CikGroup* it=new CikGroup();
-        it->serialize(ar);
-        App::currentInstance->ikGroupContainer->addIkGroup(it);
+        int ikGroupCnt=0;
+        if (ok)
+        {
+            ikGroupCnt=ar.readInt();
+            ok=( (!ar.hasFailed())&&(ikGroupCnt>=0) );
+        }
+
+        for (int i=0;ok&&(i<ikGroupCnt);i++)
+        {
+            CikGroup* it=new CikGroup();
+            it->serialize(ar);
+            if (ar.hasFailed())
+            {
+                delete it;
+                ok=false;
+                break;
+            }
+            App::currentInstance->ikGroupContainer->addIkGroup(it);
+        }
     }
 
     for (size_t i=0;i<App::currentInstance->ikGroupContainer->ikGroups.size();i++)
@@ -316,6 +761,118 @@ void CObjectContainer::importKinematicsData(CSerialization& ar)
         CikGroup* it=App::currentInstance->ikGroupContainer->ikGroups[i];
         it->performObjectLoadingMapping(&objectMapping);
     }
+    if (!ok)
+    {
+        removeAllObjects();
+        App::currentInstance->ikGroupContainer->removeAllIkGroups();
+    }
+    return(ok);
+}
+
+void CObjectContainer::exportKinematicsData(CSerialization& ar) const
+{ // Writes the binary format described in ikBinaryFormat.h. Objects are written in creation order, like
+  // CoppeliaSim does, so that loading the data gives the same object order
+    const std::vector<CikGroup*>& groups=App::currentInstance->ikGroupContainer->ikGroups;
+    std::string stringTable;
+    std::vector<int> objectNames(objectList.size());
+    for (size_t i=0;i<objectList.size();i++)
+    {
+        objectNames[i]=int(stringTable.size());
+        stringTable+=getObject(objectList[i])->getObjectName();
+        stringTable.push_back(0);
+    }
+    std::vector<int> groupNames(groups.size());
+    int elementCnt=0;
+    for (size_t i=0;i<groups.size();i++)
+    {
+        groupNames[i]=int(stringTable.size());
+        stringTable+=groups[i]->getObjectName();
+        stringTable.push_back(0);
+        elementCnt+=int(groups[i]->ikElements.size());
+    }
+
+    int header[IK_BINARY_HEADER_INTS];
+    header[IK_BINARY_HEADER_MAGIC]=IK_BINARY_FORMAT_MAGIC;
+    header[IK_BINARY_HEADER_VERSION]=IK_BINARY_FORMAT_VERSION;
+    header[IK_BINARY_HEADER_REAL_SIZE]=int(sizeof(simReal));
+    header[IK_BINARY_HEADER_OBJECT_CNT]=int(objectList.size());
+    header[IK_BINARY_HEADER_IKGROUP_CNT]=int(groups.size());
+    header[IK_BINARY_HEADER_IKELEMENT_CNT]=elementCnt;
+    header[IK_BINARY_HEADER_STRING_TABLE_SIZE]=int(stringTable.size());
+    ar.writeInts(header,IK_BINARY_HEADER_INTS);
+
+    for (size_t i=0;i<objectList.size();i++)
+    {
+        SIkObjectRecord rec=SIkObjectRecord();
+        getObject(objectList[i])->writeRecord(rec);
+        rec.ints[IK_OBJECT_NAME]=objectNames[i];
+        ar.writeInts(rec.ints,IK_OBJECT_RECORD_INTS);
+        ar.writeReals(rec.reals,IK_OBJECT_RECORD_REALS);
+    }
+    for (size_t i=0;i<groups.size();i++)
+    {
+        SIkGroupRecord rec=SIkGroupRecord();
+        groups[i]->writeRecord(rec);
+        rec.ints[IK_GROUP_NAME]=groupNames[i];
+        ar.writeInts(rec.ints,IK_GROUP_RECORD_INTS);
+        ar.writeReals(rec.reals,IK_GROUP_RECORD_REALS);
+    }
+    for (size_t i=0;i<groups.size();i++)
+    {
+        for (size_t j=0;j<groups[i]->ikElements.size();j++)
+        {
+            SIkElementRecord rec=SIkElementRecord();
+            groups[i]->ikElements[j]->writeRecord(rec);
+            ar.writeInts(rec.ints,IK_ELEMENT_RECORD_INTS);
+            ar.writeReals(rec.reals,IK_ELEMENT_RECORD_REALS);
+        }
+    }
+    ar.writeBytes(stringTable.data(),stringTable.size());
+}
+
+static bool _isOldHandleLower(const std::pair<int,int>& a,const std::pair<int,int>& b)
+{
+    return(a.first<b.first);
+}
+
+void CObjectContainer::prepareFastLoadingMapping(std::vector<int>& map) const
+{ // map holds (old handle,new handle) pairs. It is turned into a table indexed by old handle, for constant time lookups
+  // with _getLoadingMapping. If the old handles are too sparse for that, the pairs are sorted instead
+    size_t pairCnt=map.size()/2;
+    std::vector<int> pairs;
+    pairs.swap(map);
+    int minVal=0;
+    int maxVal=-1;
+    for (size_t i=0;i<pairCnt;i++)
+    {
+        if ( (i==0)||(pairs[2*i+0]<minVal) )
+            minVal=pairs[2*i+0];
+        if ( (i==0)||(pairs[2*i+0]>maxVal) )
+            maxVal=pairs[2*i+0];
+    }
+    long long range=(long long)maxVal-(long long)minVal+1;
+    if (range<=(long long)(4*pairCnt+1024))
+    {
+        map.assign(size_t(range)+2,-1);
+        map[0]=IK_LOADING_MAPPING_DENSE;
+        map[1]=minVal;
+        for (size_t i=pairCnt;i>0;i--) // the first pair wins for duplicate old handles
+            map[size_t((long long)pairs[2*i-2]-minVal)+2]=pairs[2*i-1];
+    }
+    else
+    {
+        std::vector<std::pair<int,int> > sorted(pairCnt);
+        for (size_t i=0;i<pairCnt;i++)
+            sorted[i]=std::make_pair(pairs[2*i+0],pairs[2*i+1]);
+        std::stable_sort(sorted.begin(),sorted.end(),_isOldHandleLower);
+        map.reserve(1+2*pairCnt);
+        map.push_back(IK_LOADING_MAPPING_SORTED);
+        for (size_t i=0;i<pairCnt;i++)
+        {
+            map.push_back(sorted[i].first);
+            map.push_back(sorted[i].second);
+        }
+    }
 }
 
 void CObjectContainer::addObjectToScene(CSceneObject* newObject)
@@ -326,37 +883,16 @@ void CObjectContainer::addObjectToScene(CSceneObject* newObject)
         newObjName="0";
         newObject->setObjectName(newObjName);
     }
-    while (getObject(newObjName)!=nullptr)
-    {
-        char aChar=newObjName[newObjName.length()-1];
-        std::string oldNumber("");
-        while ( (aChar>='0')&&(aChar<='9') )
-        {
-            oldNumber.insert(oldNumber.begin(),aChar);
-            newObjName.erase(newObjName.end()-1);
-            if (newObjName.length()!=0)
-                aChar=newObjName[newObjName.length()-1];
-            else
-                aChar='a';
-        }
-        if (oldNumber.length()==0)
-            newObjName=newObjName+"0";
-        else
-            newObjName=newObjName+std::to_string(atoi(oldNumber.c_str())+1);
-    }
 
-    // Give the object a new identifier
+    // Give the object a new identifier (the lowest free one):
     int id=-1;
-    for (size_t i=0;i<_objectIndex.size();i++)
+    if (_freeObjectHandles.size()!=0)
     {
-        if (_objectIndex[i]==nullptr)
-        {
-            _objectIndex[i]=newObject;
-            id=int(i);
-            break;
-        }
+        id=_freeObjectHandles.top();
+        _freeObjectHandles.pop();
+        _objectIndex[size_t(id)]=newObject;
     }
-    if (id==-1)
+    else
     {
         id=int(_objectIndex.size());
         _objectIndex.push_back(newObject);
@@ -365,7 +901,34 @@ void CObjectContainer::addObjectToScene(CSceneObject* newObject)
     // set the new handle to the object:
     newObject->setObjectHandle(id);
     objectList.push_back(id);
-
-    // Actualize the object information
-    actualizeObjectInformation();
+    if (_creationStamps.size()<_objectIndex.size())
+        _creationStamps.resize(_objectIndex.size());
+    _creationStamps[size_t(id)]=_nextCreationStamp++;
+    _addObjectName(newObjName,id);
+
+    // Update the object information. The new object comes last in objectList:
+    bool modelValid=(_kinematicModel.getVersion()==_topologyVersion);
+    incrementTopologyVersion();
+    if ( modelValid&&_kinematicModel.appendObject(newObject) )
+        _kinematicModel.setVersion(_topologyVersion);
+    if (!_deferObjectInformation)
+    {
+        if (newObject->getParentObject()!=nullptr)
+            newObject->getParentObject()->childList.push_back(newObject);
+        else if (!_editingScene)
+            orphanList.push_back(id);
+        if (newObject->getObjectType()==sim_object_joint_type)
+        {
+            if (!_editingScene)
+                jointList.push_back(id);
+            CJoint* master=getDependencyMaster(static_cast<CJoint*>(newObject));
+            if (master!=nullptr)
+                _insertInCreationOrder(master->dependentJoints,static_cast<CJoint*>(newObject));
+        }
+        if ( (newObject->getObjectType()==sim_object_dummy_type)&&(!_editingScene) )
+            dummyList.push_back(id);
+#ifdef IK_CHECK_OBJECT_INFORMATION
+        assert(_checkObjectInformation());
+#endif
+    }
 }
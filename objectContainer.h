@@ -4,6 +4,11 @@
 #include "sceneObject.h"
 #include "joint.h"
 #include "ikGroup.h"
+#include "kinematicModel.h"
+#include <unordered_map>
+#include <queue>
+#include <functional>
+#include <mutex>
 
 class CObjectContainer
 {
@@ -14,6 +19,19 @@ public:
     void newSceneProcedure();
     void removeAllObjects();
     void actualizeObjectInformation();
+    unsigned int getTopologyVersion() const;
+    void incrementTopologyVersion(bool kinematicModelAffected=true);
+    void beginSceneEdit();
+    void endSceneEdit();
+    bool isEditingScene() const;
+    void announceObjectMoved(const CSceneObject* object);
+    void setConcurrentAccess(bool concurrent);
+    void announceObjectNameWillChange(const CSceneObject* object,const std::string& newName);
+    void announceObjectParentChanged(CSceneObject* object,CSceneObject* previousParent);
+    CJoint* getDependencyMaster(const CJoint* joint) const;
+    void announceJointDependencyChanged(CJoint* joint,CJoint* previousMaster);
+    bool getWorldTransformation(const CSceneObject* object,C7Vector& tr);
+    void getWorldTransformationsBatch(size_t frameCnt,const CSceneObject* const* frames,size_t jointCnt,const CJoint* const* joints,size_t configCnt,const simReal* configs,C7Vector* poses);
 
     int getObjectHandle(const std::string& objectName) const;
     CSceneObject* getObject(int objectHandle) const;
@@ -42,7 +60,37 @@ public:
     std::vector<int> jointList;
     std::vector<int> dummyList;
 
-    void importKinematicsData(CSerialization& ar);
+    bool importKinematicsData(CSerialization& ar);
+    void exportKinematicsData(CSerialization& ar) const;
+    void prepareFastLoadingMapping(std::vector<int>& map) const;
+    CObjectContainer* copyYourself() const;
     void addObjectToScene(CSceneObject* newObject);
+
+private:
+    void _computeObjectInformation(std::vector<std::vector<CSceneObject*> >& childLists,std::vector<int>& joints,std::vector<int>& dummies,std::vector<int>& orphans,std::vector<std::vector<CJoint*> >& dependentJointLists) const;
+    bool _checkObjectInformation() const;
+    template<class T> static void _eraseFromBack(std::vector<T>& list,const T& item);
+    void _insertInCreationOrder(std::vector<int>& list,int objectHandle) const;
+    void _insertInCreationOrder(std::vector<CSceneObject*>& list,CSceneObject* object) const;
+    void _insertInCreationOrder(std::vector<CJoint*>& list,CJoint* joint) const;
+    void _addObjectName(const std::string& name,int objectHandle);
+    void _removeObjectName(const std::string& name,int objectHandle);
+
+    // childList, jointList, dummyList, orphanList and dependentJoints are updated incrementally, and are ordered like objectList, i.e.
+    // by creation stamp. While loading, that bookkeeping is deferred and done with a single actualizeObjectInformation at the end:
+    std::priority_queue<int,std::vector<int>,std::greater<int> > _freeObjectHandles; // entries of _objectIndex that are nullptr
+    std::vector<unsigned long long> _creationStamps; // by object handle
+    unsigned long long _nextCreationStamp;
+    bool _deferObjectInformation;
+    bool _editingScene; // between beginSceneEdit and endSceneEdit. Only the orphan, joint and dummy lists are deferred
+    bool _erasingObject; // joints and children are notified one after the other, the information is only consistent once done
+    bool _concurrentAccess; // while IK groups are computed on several threads. Moved objects are then announced under _announceMutex
+    std::mutex _announceMutex;
+
+    // Names are not unique (e.g. unnamed frames are all called "dummy"). A name maps to the first object in objectList with that name:
+    std::unordered_map<std::string,int> _objectHandlesByName;
+    std::unordered_map<std::string,size_t> _objectNameCnts; // objects with that name
+    unsigned int _topologyVersion; // changes with the parenting, the object set or a joint mode. Never 0
+    CKinematicModel _kinematicModel;
 };
 
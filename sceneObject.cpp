@@ -1,6 +1,7 @@
 #include "simConst.h"
 #include "sceneObject.h"
 #include "app.h"
+#include "ikKernels.h"
 
 CSceneObject::CSceneObject()
 {
@@ -8,6 +9,7 @@ CSceneObject::CSceneObject()
     _parentObject=nullptr;
     _parentObjectHandle=-1;
     _transformation.setIdentity();
+    _tempCumulativeTransformationValid=false;
 }
 
 CSceneObject::~CSceneObject()
@@ -18,19 +20,44 @@ void CSceneObject::performSceneObjectLoadingMapping(const std::vector<int>* map)
 {
 }
 
+CSceneObject* CSceneObject::copyYourself() const
+{ // Pointers to other objects still refer to the original environment, until performObjectCopyMapping is called
+    return(new CSceneObject(*this));
+}
+
+void CSceneObject::performObjectCopyMapping(const std::vector<CSceneObject*>& objectIndex)
+{
+    performObjectCopyMappingMain(objectIndex);
+}
+
+void CSceneObject::performObjectCopyMappingMain(const std::vector<CSceneObject*>& objectIndex)
+{ // objectIndex is the object index of the copied environment
+    if (_parentObject!=nullptr)
+        _parentObject=objectIndex[size_t(_parentObject->getObjectHandle())];
+    for (size_t i=0;i<childList.size();i++)
+        childList[i]=objectIndex[size_t(childList[i]->getObjectHandle())];
+}
+
 void CSceneObject::performSceneObjectLoadingMappingMain(const std::vector<int>* map)
 {
     int newParentHandle=_getLoadingMapping(map,_parentObjectHandle);
     setParentObject(App::currentInstance->objectContainer->getObject(newParentHandle));
 }
 
+int CSceneObject::getLoadedParentObjectHandle() const
+{ // Parent handle as read by serialize, i.e. before the loading mapping
+    return(_parentObjectHandle);
+}
+
 std::string CSceneObject::getObjectName() const
 {
     return(_objectName);
 }
 
 void CSceneObject::setObjectName(std::string newName)
-{ 
+{ // Objects already in the scene need to update the container's name index
+    if ( (App::currentInstance!=nullptr)&&(App::currentInstance->objectContainer->getObject(_objectHandle)==this) )
+        App::currentInstance->objectContainer->announceObjectNameWillChange(this,newName);
     _objectName=newName;
 }
 
@@ -66,10 +93,40 @@ C7Vector CSceneObject::getParentCumulativeTransformation(bool tempVals) const
 
 C7Vector CSceneObject::getCumulativeTransformation(bool tempVals) const
 {
-    if (getParentObject()==nullptr)
-        return(getLocalTransformation(tempVals));
+    if (!tempVals)
+    {
+        C7Vector tr;
+        if (App::currentInstance->objectContainer->getWorldTransformation(this,tr))
+            return(tr);
+        if (getParentObject()==nullptr) // object is not (yet) part of the scene
+            return(getLocalTransformation(tempVals));
+        return(CIkKernels::multiplyInChain(getParentCumulativeTransformation(tempVals),getLocalTransformation(tempVals)));
+    }
+    // Temp. values are cached until this object or one of its ancestors moves:
+    if (!_tempCumulativeTransformationValid)
+    {
+        if (getParentObject()==nullptr)
+            _tempCumulativeTransformation=getLocalTransformation(tempVals);
+        else
+            _tempCumulativeTransformation=CIkKernels::multiplyInChain(getParentCumulativeTransformation(tempVals),getLocalTransformation(tempVals));
+        _tempCumulativeTransformationValid=true;
+    }
+    return(_tempCumulativeTransformation);
+}
+
+void CSceneObject::_invalidateCumulativeTransformation(bool tempVals)
+{ // Invalidates the cached pose of this object and of its descendants
+    if (!tempVals)
+        App::currentInstance->objectContainer->announceObjectMoved(this);
     else
-        return(getParentCumulativeTransformation(tempVals)*getLocalTransformation(tempVals));
+    { // Descendants of an invalid object are already invalid:
+        if (_tempCumulativeTransformationValid)
+        {
+            _tempCumulativeTransformationValid=false;
+            for (size_t j=0;j<childList.size();j++)
+                childList[j]->_invalidateCumulativeTransformation(tempVals);
+        }
+    }
 }
 
 C7Vector CSceneObject::getCumulativeTransformationPart1(bool tempVals) const
@@ -79,7 +136,7 @@ C7Vector CSceneObject::getCumulativeTransformationPart1(bool tempVals) const
         if (getParentObject()==nullptr)
             return(getLocalTransformationPart1(tempVals));
         else
-            return(getParentCumulativeTransformation(tempVals)*getLocalTransformationPart1(tempVals));
+            return(CIkKernels::multiplyInChain(getParentCumulativeTransformation(tempVals),getLocalTransformationPart1(tempVals)));
     }
     else
         return(getCumulativeTransformation(tempVals));
@@ -89,7 +146,7 @@ C7Vector CSceneObject::getLocalTransformation(bool tempVals) const
 {
     if (getObjectType()==sim_object_joint_type)
     {
-        const CJoint* it=dynamic_cast<const CJoint*>(this);
+        const CJoint* it=static_cast<const CJoint*>(this);
         C7Vector jointTr;
         jointTr.setIdentity();
         simReal val;
@@ -110,40 +167,40 @@ C7Vector CSceneObject::getLocalTransformation(bool tempVals) const
                     jointTr.Q.setEulerAngles(simZero,simZero,it->getTempParameterEx(2));
                     C4Vector q2;
                     q2.setEulerAngles(piValD2,simZero,simZero);
-                    jointTr.Q=q2*jointTr.Q;
+                    jointTr.Q=CIkKernels::multiply(q2,jointTr.Q);
 
                     q2.setEulerAngles(simZero,simZero,it->getTempParameterEx(1));
-                    jointTr.Q=q2*jointTr.Q;
+                    jointTr.Q=CIkKernels::multiply(q2,jointTr.Q);
                     q2.setEulerAngles(-piValD2,simZero,-piValD2);
-                    jointTr.Q=q2*jointTr.Q;
+                    jointTr.Q=CIkKernels::multiply(q2,jointTr.Q);
 
                     q2.setEulerAngles(simZero,simZero,it->getTempParameterEx(0));
-                    jointTr.Q=q2*jointTr.Q;
+                    jointTr.Q=CIkKernels::multiply(q2,jointTr.Q);
                     q2.setEulerAngles(simZero,piValD2,simZero);
-                    jointTr.Q=q2*jointTr.Q;
+                    jointTr.Q=CIkKernels::multiply(q2,jointTr.Q);
                     q2=it->getSphericalTransformation();
-                    jointTr.Q=q2*jointTr.Q;
+                    jointTr.Q=CIkKernels::multiply(q2,jointTr.Q);
                 }
                 else
                 { // Used by the IK routine when close to joint limitations
                     jointTr.Q.setEulerAngles(simZero,simZero,it->getTempParameterEx(2));
                     C4Vector q2;
                     q2.setEulerAngles(simZero,-piValD2,simZero);
-                    jointTr.Q=q2*jointTr.Q;
+                    jointTr.Q=CIkKernels::multiply(q2,jointTr.Q);
 
                     q2.setEulerAngles(simZero,simZero,it->getTempParameterEx(1));
-                    jointTr.Q=q2*jointTr.Q;
+                    jointTr.Q=CIkKernels::multiply(q2,jointTr.Q);
                     q2.setEulerAngles(simZero,piValD2,simZero);
-                    jointTr.Q=q2*jointTr.Q;
+                    jointTr.Q=CIkKernels::multiply(q2,jointTr.Q);
 
                     q2.setEulerAngles(simZero,simZero,it->getTempParameterEx(0));
-                    jointTr.Q=q2*jointTr.Q;
+                    jointTr.Q=CIkKernels::multiply(q2,jointTr.Q);
                 }
             }
             else
                 jointTr.Q=it->getSphericalTransformation();
         }
-        return(_transformation*jointTr);
+        return(CIkKernels::multiply(_transformation,jointTr));
     }
     else
         return(_transformation);
@@ -157,16 +214,22 @@ C7Vector CSceneObject::getLocalTransformationPart1(bool tempVals) const
 void CSceneObject::setLocalTransformation(const C7Vector& v)
 {
     _transformation=v;
+    _invalidateCumulativeTransformation(false);
+    _invalidateCumulativeTransformation(true);
 }
 
 void CSceneObject::setLocalTransformation(const C4Vector& q)
 {
     _transformation.Q=q;
+    _invalidateCumulativeTransformation(false);
+    _invalidateCumulativeTransformation(true);
 }
 
 void CSceneObject::setLocalTransformation(const C3Vector& x)
 {
     _transformation.X=x;
+    _invalidateCumulativeTransformation(false);
+    _invalidateCumulativeTransformation(true);
 }
 
 int CSceneObject::getObjectHandle() const
@@ -196,8 +259,12 @@ void CSceneObject::setParentObject(CSceneObject* newParentObject)
 {
     if (newParentObject!=this)
     {
+        CSceneObject* previousParent=_parentObject;
         _parentObject=newParentObject;
-        App::currentInstance->objectContainer->actualizeObjectInformation();
+        if (App::currentInstance->objectContainer->getObject(_objectHandle)==this)
+            App::currentInstance->objectContainer->announceObjectParentChanged(this,previousParent);
+        _invalidateCumulativeTransformation(false);
+        _invalidateCumulativeTransformation(true);
     }
 }
 
@@ -217,14 +284,47 @@ void CSceneObject::serialize(CSerialization& ar)
 
 void CSceneObject::serializeMain(CSerialization& ar)
 {
-    _transformation.Q(0)=simReal(ar.readFloat());
-    _transformation.Q(1)=simReal(ar.readFloat());
-    _transformation.Q(2)=simReal(ar.readFloat());
-    _transformation.Q(3)=simReal(ar.readFloat());
-    _transformation.X(0)=simReal(ar.readFloat());
-    _transformation.X(1)=simReal(ar.readFloat());
-    _transformation.X(2)=simReal(ar.readFloat());
+    float tr[7];
+    ar.readFloats(tr,7);
+    _transformation.Q(0)=simReal(tr[0]);
+    _transformation.Q(1)=simReal(tr[1]);
+    _transformation.Q(2)=simReal(tr[2]);
+    _transformation.Q(3)=simReal(tr[3]);
+    _transformation.X(0)=simReal(tr[4]);
+    _transformation.X(1)=simReal(tr[5]);
+    _transformation.X(2)=simReal(tr[6]);
     _objectHandle=ar.readInt();
     _parentObjectHandle=ar.readInt();
-    _objectName=ar.readString().c_str();
+    _objectName=ar.readString();
+}
+
+void CSceneObject::writeRecord(SIkObjectRecord& /*rec*/) const
+{
+}
+
+void CSceneObject::writeRecordMain(SIkObjectRecord& rec) const
+{ // The name is handled by the caller
+    rec.ints[IK_OBJECT_TYPE]=_objectType;
+    rec.ints[IK_OBJECT_HANDLE]=_objectHandle;
+    rec.ints[IK_OBJECT_PARENT_HANDLE]=-1;
+    if (_parentObject!=nullptr)
+        rec.ints[IK_OBJECT_PARENT_HANDLE]=_parentObject->getObjectHandle();
+    for (size_t i=0;i<4;i++)
+        rec.reals[IK_OBJECT_TRANSFORMATION+i]=_transformation.Q(i);
+    for (size_t i=0;i<3;i++)
+        rec.reals[IK_OBJECT_TRANSFORMATION+4+i]=_transformation.X(i);
+}
+
+void CSceneObject::readRecord(const SIkObjectRecord& /*rec*/)
+{
+}
+
+void CSceneObject::readRecordMain(const SIkObjectRecord& rec)
+{ // The name is handled by the caller
+    for (size_t i=0;i<4;i++)
+        _transformation.Q(i)=rec.reals[IK_OBJECT_TRANSFORMATION+i];
+    for (size_t i=0;i<3;i++)
+        _transformation.X(i)=rec.reals[IK_OBJECT_TRANSFORMATION+4+i];
+    _objectHandle=rec.ints[IK_OBJECT_HANDLE];
+    _parentObjectHandle=rec.ints[IK_OBJECT_PARENT_HANDLE];
 }
@@ -3,6 +3,7 @@
 #include "ik.h"
 #include <vector>
 #include "serialization.h"
+#include "ikBinaryFormat.h"
 #include "3Vector.h"
 #include "4Vector.h"
 #include "7Vector.h"
@@ -19,8 +20,16 @@ public:
     void announceIkGroupWillBeErasedMain(int ikGroupHandle);
     virtual void performSceneObjectLoadingMapping(const std::vector<int>* map);
     void performSceneObjectLoadingMappingMain(const std::vector<int>* map);
+    int getLoadedParentObjectHandle() const;
     virtual void serialize(CSerialization& ar);
     void serializeMain(CSerialization& ar);
+    virtual void writeRecord(SIkObjectRecord& rec) const;
+    void writeRecordMain(SIkObjectRecord& rec) const;
+    virtual void readRecord(const SIkObjectRecord& rec);
+    void readRecordMain(const SIkObjectRecord& rec);
+    virtual CSceneObject* copyYourself() const;
+    virtual void performObjectCopyMapping(const std::vector<CSceneObject*>& objectIndex);
+    void performObjectCopyMappingMain(const std::vector<CSceneObject*>& objectIndex);
 
     C7Vector getParentCumulativeTransformation(bool tempVals=false) const;
     C7Vector getCumulativeTransformation(bool tempVals=false) const;
@@ -44,10 +53,17 @@ public:
     std::vector<CSceneObject*> childList;
 
 protected:
+    void _invalidateCumulativeTransformation(bool tempVals);
+
     int _objectHandle;
     std::string _objectName;
     C7Vector _transformation;
     CSceneObject* _parentObject;
     int _parentObjectHandle;
     int _objectType;
+
+    // Cached getCumulativeTransformation result for the temp. (IK) values. When invalid, all descendants are also invalid.
+    // Poses with the real values come from CObjectContainer's flattened kinematic model:
+    mutable C7Vector _tempCumulativeTransformation;
+    mutable bool _tempCumulativeTransformationValid;
 };
@@ -1,42 +1,184 @@
 #include "serialization.h"
+#include <cstring>
+
+CSerialization::CSerialization()
+{
+    _buffer=nullptr;
+    _bufferSize=0;
+    _readPos=0;
+    _failed=false;
+}
 
 CSerialization::CSerialization(const unsigned char* data,size_t dataSize)
 {
     _buffer=data;
     _bufferSize=dataSize;
     _readPos=0;
+    _failed=false;
 }
 
 CSerialization::~CSerialization()
 {
 }
 
+bool CSerialization::_canRead(size_t byteCnt)
+{ // One bounds check per read, whatever the read size
+    if ( (!_failed)&&(byteCnt<=_bufferSize-_readPos) )
+        return(true);
+    _failed=true;
+    return(false);
+}
+
 unsigned char CSerialization::readByte()
 {
+    if (!_canRead(1))
+        return(0);
     return(_buffer[_readPos++]);
 }
 
 int CSerialization::readInt()
 {
-    unsigned char tmp[sizeof(int)];
-    for (size_t i=0;i<sizeof(int);i++)
-        tmp[i]=_buffer[_readPos++];
-    return((reinterpret_cast<int*>(&tmp))[0]);
+    int retVal=0;
+    if (_canRead(sizeof(int)))
+    {
+        memcpy(&retVal,_buffer+_readPos,sizeof(int));
+        _readPos+=sizeof(int);
+    }
+    return(retVal);
 }
 
 float CSerialization::readFloat()
 {
-    unsigned char tmp[sizeof(float)];
-    for (size_t i=0;i<sizeof(float);i++)
-        tmp[i]=_buffer[_readPos++];
-    return((reinterpret_cast<float*>(&tmp))[0]);
+    float retVal=0.0f;
+    if (_canRead(sizeof(float)))
+    {
+        memcpy(&retVal,_buffer+_readPos,sizeof(float));
+        _readPos+=sizeof(float);
+    }
+    return(retVal);
 }
 
-std::string CSerialization::readString()
+void CSerialization::readFloats(float* values,size_t cnt)
 {
+    if (_canRead(cnt*sizeof(float)))
+    {
+        memcpy(values,_buffer+_readPos,cnt*sizeof(float));
+        _readPos+=cnt*sizeof(float);
+    }
+    else
+    {
+        for (size_t i=0;i<cnt;i++)
+            values[i]=0.0f;
+    }
+}
+
+void CSerialization::readInts(int* values,size_t cnt)
+{
+    if (_canRead(cnt*sizeof(int)))
+    {
+        memcpy(values,_buffer+_readPos,cnt*sizeof(int));
+        _readPos+=cnt*sizeof(int);
+    }
+    else
+    {
+        for (size_t i=0;i<cnt;i++)
+            values[i]=0;
+    }
+}
+
+void CSerialization::readReals(simReal* values,size_t cnt,size_t realSize)
+{ // realSize is the size of the stored values (4 or 8), which are converted if needed
+    if ( ((realSize==sizeof(float))||(realSize==sizeof(double)))&&_canRead(cnt*realSize) )
+    {
+        if (realSize==sizeof(simReal))
+            memcpy(values,_buffer+_readPos,cnt*sizeof(simReal));
+        else if (realSize==sizeof(float))
+        {
+            for (size_t i=0;i<cnt;i++)
+            {
+                float v;
+                memcpy(&v,_buffer+_readPos+i*sizeof(float),sizeof(float));
+                values[i]=simReal(v);
+            }
+        }
+        else
+        {
+            for (size_t i=0;i<cnt;i++)
+            {
+                double v;
+                memcpy(&v,_buffer+_readPos+i*sizeof(double),sizeof(double));
+                values[i]=simReal(v);
+            }
+        }
+        _readPos+=cnt*realSize;
+    }
+    else
+    {
+        _failed=true;
+        for (size_t i=0;i<cnt;i++)
+            values[i]=simReal(0.0);
+    }
+}
+
+std::string CSerialization::readString()
+{ // Zero-terminated
     std::string retVal;
-    while (_buffer[_readPos]!=0)
-        retVal+=char(_buffer[_readPos++]);
-    _readPos++;
+    if (!_failed)
+    {
+        const void* end=memchr(_buffer+_readPos,0,_bufferSize-_readPos);
+        if (end!=nullptr)
+        {
+            size_t l=size_t(static_cast<const unsigned char*>(end)-(_buffer+_readPos));
+            retVal.assign(reinterpret_cast<const char*>(_buffer+_readPos),l);
+            _readPos+=l+1;
+        }
+        else
+            _failed=true;
+    }
     return(retVal);
 }
+
+bool CSerialization::getStringAt(size_t pos,std::string& str) const
+{ // Zero-terminated string at an absolute position. Does not change the read position
+    if (pos<_bufferSize)
+    {
+        const void* end=memchr(_buffer+pos,0,_bufferSize-pos);
+        if (end!=nullptr)
+        {
+            str.assign(reinterpret_cast<const char*>(_buffer+pos),size_t(static_cast<const unsigned char*>(end)-(_buffer+pos)));
+            return(true);
+        }
+    }
+    return(false);
+}
+
+size_t CSerialization::getRemainingSize() const
+{
+    return(_bufferSize-_readPos);
+}
+
+bool CSerialization::hasFailed() const
+{
+    return(_failed);
+}
+
+void CSerialization::writeInts(const int* values,size_t cnt)
+{
+    writeBytes(values,cnt*sizeof(int));
+}
+
+void CSerialization::writeReals(const simReal* values,size_t cnt)
+{
+    writeBytes(values,cnt*sizeof(simReal));
+}
+
+void CSerialization::writeBytes(const void* data,size_t size)
+{
+    const unsigned char* d=static_cast<const unsigned char*>(data);
+    _writtenData.insert(_writtenData.end(),d,d+size);
+}
+
+const std::vector<unsigned char>& CSerialization::getWrittenData() const
+{
+    return(_writtenData);
+}
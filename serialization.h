@@ -2,21 +2,39 @@
 
 #include "ik.h"
 #include <string>
+#include <vector>
 
 class CSerialization
 {
 public:
 
-    CSerialization(const unsigned char* data,size_t dataSize);
+    CSerialization(); // for writing
+    CSerialization(const unsigned char* data,size_t dataSize); // for reading
     ~CSerialization();
 
+    // Reading past the end of the data sets the failed state, after which reads return 0 or an empty string:
     unsigned char readByte();
     int readInt();
     float readFloat();
+    void readFloats(float* values,size_t cnt);
+    void readInts(int* values,size_t cnt);
+    void readReals(simReal* values,size_t cnt,size_t realSize);
     std::string readString();
+    bool getStringAt(size_t pos,std::string& str) const;
+    size_t getRemainingSize() const;
+    bool hasFailed() const;
+
+    void writeInts(const int* values,size_t cnt);
+    void writeReals(const simReal* values,size_t cnt);
+    void writeBytes(const void* data,size_t size);
+    const std::vector<unsigned char>& getWrittenData() const;
 
 private:
+    bool _canRead(size_t byteCnt);
+
     const unsigned char* _buffer;
     size_t _bufferSize;
     size_t _readPos;
+    bool _failed;
+    std::vector<unsigned char> _writtenData;
 };